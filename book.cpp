@@ -1,72 +1,134 @@
-#ifndef USER_H
-#define USER_H
+#include "book.h"
+#include "statements.h"
+#include "logger.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <stdexcept>
 
-#include <QString>
-#include <QSqlDatabase>
+/**
+ * @brief Конструктор класса Book
+ * @param title Название книги
+ * @param author Автор книги
+ * @param category Категория книги
+ * @param availability_count Количество доступных экземпляров
+ * @throws std::invalid_argument Если availability_count отрицательный
+ */
+Book::Book(const QString &title, const QString &author,
+           const QString &category, int availability_count)
+    : title_(title), author_(author), category_(category)
+{
+    set_availability_count(availability_count);
+}
+
+/**
+ * @brief Возвращает название книги
+ * @return Название книги
+ */
+const QString &Book::title() const {
+    return title_;
+}
+
+/**
+ * @brief Возвращает автора книги
+ * @return Автор книги
+ */
+const QString &Book::author() const {
+    return author_;
+}
+
+/**
+ * @brief Возвращает категорию книги
+ * @return Категория книги
+ */
+const QString &Book::category() const {
+    return category_;
+}
+
+/**
+ * @brief Возвращает количество доступных экземпляров
+ * @return Количество доступных экземпляров
+ */
+int Book::availability_count() const {
+    return availability_count_;
+}
+
+/**
+ * @brief Устанавливает количество доступных экземпляров
+ * @param count Новое количество
+ * @throws std::invalid_argument Если count отрицательный
+ */
+void Book::set_availability_count(int count) {
+    if (count < 0) {
+        throw std::invalid_argument("availability_count не может быть отрицательным");
+    }
+    availability_count_ = count;
+}
+
+/**
+ * @brief Находит ID автора в базе данных
+ * @param author Автор в формате "Имя Фамилия"
+ * @return ID автора или -1, если автор не найден
+ */
+int Book::get_author_id(const QString &author) {
+    auto query = sql::default_cache().exec<stmt::FindAuthor>(author);
+    if (!query.next()) {
+        return -1;
+    }
+    return query.row().author_id;
+}
 
 /**
- * @brief Класс, представляющий пользователя библиотеки
- *
- * Инкапсулирует данные о пользователе библиотечной системы:
- * - Имя и фамилию
- * - Номер читательского билета
- * - Методы работы с базой данных
+ * @brief Находит ID категории в базе данных
+ * @param category Название категории
+ * @return ID категории или -1, если категория не найдена
  */
-class User {
-public:
-    /**
-     * @brief Конструктор пользователя
-     * @param firstName Имя пользователя (не может быть пустым)
-     * @param lastName Фамилия пользователя (не может быть пустой)
-     * @param cardNumber Номер читательского билета (уникальный)
-     * @throws std::invalid_argument Если имя, фамилия или номер билета пустые
-     */
-    User(const QString& firstName, const QString& lastName, const QString& cardNumber);
-    
-    /// @name Геттеры
-    /// @{
-    /**
-     * @brief Получить имя пользователя
-     * @return Имя пользователя
-     */
-    QString getFirstName() const;
-    
-    /**
-     * @brief Получить фамилию пользователя
-     * @return Фамилия пользователя
-     */
-    QString getLastName() const;
-    
-    /**
-     * @brief Получить номер читательского билета
-     * @return Номер билета
-     */
-    QString getCardNumber() const;
-    /// @}
-    
-    /// @name Методы работы с базой данных
-    /// @{
-    /**
-     * @brief Добавить пользователя в базу данных
-     * @param user Объект пользователя для добавления
-     * @return true если операция успешна
-     * @throws std::runtime_error При ошибке SQL-запроса
-     */
-    bool addUser(const User& user);
-    
-    /**
-     * @brief Удалить пользователя из базы данных
-     * @param cardNumber Номер читательского билета
-     * @return true если операция успешна
-     * @throws std::runtime_error При ошибке SQL-запроса
-     */
-    bool deleteUser(const QString& cardNumber);
-    /// @}
-    
-private:
-    QString u_firstName;    ///< Имя пользователя
-    QString u_lastName;     ///< Фамилия пользователя
-    QString u_cardNumber;   ///< Номер читательского билета
-};
+int Book::get_category_id(const QString &category) {
+    auto query = sql::default_cache().exec<stmt::FindCategory>(category);
+    if (!query.next()) {
+        return -1;
+    }
+    return query.row().category_id;
+}
 
-#endif // USER_H
+/**
+ * @brief Добавляет книгу в базу данных
+ * @param book Книга для добавления
+ * @return true при успешном добавлении, false при ошибке
+ * @note В случае ошибки записывает событие в журнал (logger.h)
+ */
+bool Book::add_book(const Book &book) {
+    int authorId = get_author_id(book.author());
+    if (authorId < 0) {
+        LOG_WARNING("add_book").message("автор не найден");
+        return false;
+    }
+    int categoryId = get_category_id(book.category());
+    if (categoryId < 0) {
+        LOG_WARNING("add_book").message("категория не найдена");
+        return false;
+    }
+
+    auto query = sql::default_cache().exec<stmt::InsertBook>(
+        book.title(), authorId, categoryId, book.availability_count());
+    if (!query.ok()) {
+        LOG_ERROR("add_book").sql(query.error()).message("ошибка добавления книги");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Удаляет книгу из базы данных
+ * @param book Книга для удаления (по названию и автору)
+ * @return true при успешном удалении, false при ошибке
+ * @note В случае ошибки записывает событие в журнал (logger.h)
+ */
+bool Book::delete_book(const Book &book) {
+    auto query = sql::default_cache().exec<stmt::DeleteBook>(book.title(), book.author());
+    if (!query.ok()) {
+        LOG_ERROR("delete_book").sql(query.error()).message("ошибка удаления книги");
+        return false;
+    }
+    return true;
+}
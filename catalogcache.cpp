@@ -0,0 +1,548 @@
+#include "catalogcache.h"
+#include "library.h"
+#include "statements.h"
+#include "logger.h"
+#include "tracer.h"
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QtGlobal>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Ссылка на строку в таблице строк
+ */
+struct StringRef {
+    quint32 offset;  ///< Смещение от начала таблицы строк
+    quint32 size;    ///< Длина в байтах UTF-8
+};
+
+/**
+ * @brief Заголовок файла снимка
+ *
+ * Числа записываются в порядке байтов машины; файл с другим порядком
+ * (byte_order) отбрасывается, как и файл другой версии.
+ */
+struct FileHeader {
+    char magic[8];           ///< "LIBCATLG"
+    quint32 version;         ///< CatalogCache::kVersion
+    quint32 byte_order;      ///< kByteOrderMark в порядке байтов записавшей машины
+    quint32 header_size;     ///< sizeof(FileHeader)
+    quint32 book_count;      ///< Количество записей BookRecord
+    quint32 user_count;      ///< Количество записей UserRecord
+    quint32 reserved;        ///< Выравнивание, 0
+    quint64 strings_offset;  ///< Смещение таблицы строк от начала файла
+    quint64 strings_size;    ///< Размер таблицы строк
+    qint64 synced_at_ms;     ///< Время сервера последней дельты
+    quint64 checksum;        ///< FNV-1a всего, что следует за заголовком
+};
+
+/**
+ * @brief Запись книги фиксированной длины
+ */
+struct BookRecord {
+    qint32 book_id;
+    qint32 availability_count;
+    StringRef title;
+    StringRef author;
+    StringRef category;
+};
+
+/**
+ * @brief Запись пользователя фиксированной длины
+ */
+struct UserRecord {
+    qint32 user_id;
+    StringRef card_number;
+    StringRef name;
+};
+
+static_assert(sizeof(FileHeader) == 64, "формат заголовка не должен зависеть от компилятора");
+static_assert(sizeof(BookRecord) == 32, "формат записи книги не должен зависеть от компилятора");
+static_assert(sizeof(UserRecord) == 20, "формат записи пользователя не должен зависеть от компилятора");
+
+const char kMagic[8] = {'L', 'I', 'B', 'C', 'A', 'T', 'L', 'G'};
+const quint32 kByteOrderMark = 0x01020304;
+
+quint64 fnv1a(const uchar *data, qint64 size)
+{
+    quint64 hash = 0xcbf29ce484222325ULL;
+    for (qint64 i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Таблица строк с удалением повторов
+ */
+class StringTable {
+public:
+    StringRef add(const QByteArray &utf8)
+    {
+        const auto it = refs_.constFind(utf8);
+        if (it != refs_.constEnd()) {
+            return it.value();
+        }
+        const StringRef ref{quint32(data_.size()), quint32(utf8.size())};
+        data_ += utf8;
+        refs_.insert(utf8, ref);
+        return ref;
+    }
+
+    const QByteArray &data() const { return data_; }
+
+private:
+    QByteArray data_;
+    QHash<QByteArray, StringRef> refs_;
+};
+
+/// @name Доступ к отображенному файлу (заголовок и записи уже проверены в load)
+/// @{
+BookRecord book_record(const uchar *data, qint32 index)
+{
+    BookRecord record;
+    std::memcpy(&record, data + sizeof(FileHeader) + quint64(index) * sizeof(BookRecord), sizeof(record));
+    return record;
+}
+
+UserRecord user_record(const uchar *data, quint32 books, qint32 index)
+{
+    UserRecord record;
+    std::memcpy(&record, data + sizeof(FileHeader) + quint64(books) * sizeof(BookRecord)
+                    + quint64(index) * sizeof(UserRecord), sizeof(record));
+    return record;
+}
+
+const uchar *strings_begin(const uchar *data, quint32 books, quint32 users)
+{
+    return data + sizeof(FileHeader) + quint64(books) * sizeof(BookRecord) + quint64(users) * sizeof(UserRecord);
+}
+
+bool in_bounds(const StringRef &ref, quint64 size)
+{
+    return quint64(ref.offset) + ref.size <= size;
+}
+/// @}
+
+/**
+ * @brief Сливает записи файла (по возрастанию ключа) с дельтой
+ * @param count Количество записей в файле
+ * @param id_at Ключ записи файла по номеру
+ * @param changes Строки дельты по ключу
+ * @param deleted Ключи записей файла, удаленных по журналу
+ * @param rows Строки списка по возрастанию ключа
+ */
+template <typename IdAt, typename Value, typename Rows>
+void merge_rows(quint32 count, IdAt id_at, const std::map<int, Value> &changes,
+                const std::set<int> &deleted, Rows *rows)
+{
+    rows->clear();
+    rows->reserve(count + changes.size());
+    auto change = changes.begin();
+    for (quint32 i = 0; i < count; ++i) {
+        const qint32 id = id_at(qint32(i));
+        for (; change != changes.end() && change->first < id; ++change) {
+            rows->push_back({change->first, -1});
+        }
+        if (change != changes.end() && change->first == id) {
+            ++change;
+        }
+        if (deleted.count(id) == 0) {
+            rows->push_back({id, qint32(i)});
+        }
+    }
+    for (; change != changes.end(); ++change) {
+        rows->push_back({change->first, -1});
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Путь к файлу снимка
+ * @return Путь из LIBRARY_CATALOG_CACHE или "catalog.cache"
+ */
+QString CatalogCache::default_path()
+{
+    const QString path = qEnvironmentVariable("LIBRARY_CATALOG_CACHE");
+    return path.isEmpty() ? QString("catalog.cache") : path;
+}
+
+/**
+ * @brief Деструктор; закрывает отображение файла
+ */
+CatalogCache::~CatalogCache()
+{
+    clear();
+}
+
+/**
+ * @brief Отображает снимок из файла в память
+ * @param path Путь к файлу
+ * @return true если файл прочитан и прошел проверку
+ * @note Строки не декодируются: проверяются только заголовок, контрольная
+ * сумма, порядок ключей и границы ссылок на строки. Файл остается
+ * отображенным до clear() или save()
+ */
+bool CatalogCache::load(const QString &path)
+{
+    TRACE_SPAN("CatalogCache::load");
+    clear();
+
+    file_.setFileName(path);
+    if (!file_.open(QFile::ReadOnly)) {
+        return false;
+    }
+    const qint64 fileSize = file_.size();
+    if (fileSize < qint64(sizeof(FileHeader))) {
+        LOG_WARNING("catalog_load").message("файл кеша каталога поврежден");
+        file_.close();
+        return false;
+    }
+    const uchar *data = file_.map(0, fileSize);
+    if (!data) {
+        LOG_WARNING("catalog_load").message("не удалось отобразить файл кеша каталога");
+        file_.close();
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    const quint64 recordsEnd = sizeof(FileHeader) + quint64(header.book_count) * sizeof(BookRecord)
+                             + quint64(header.user_count) * sizeof(UserRecord);
+    const bool valid = std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0
+        && header.version == kVersion
+        && header.byte_order == kByteOrderMark
+        && header.header_size == sizeof(FileHeader)
+        && header.strings_offset == recordsEnd
+        && header.strings_offset + header.strings_size == quint64(fileSize)
+        && header.checksum == fnv1a(data + sizeof(FileHeader), fileSize - qint64(sizeof(FileHeader)));
+    if (!valid) {
+        LOG_WARNING("catalog_load").message("файл кеша каталога другой версии или поврежден");
+        file_.unmap(const_cast<uchar *>(data));
+        file_.close();
+        return false;
+    }
+
+    // Ключи должны возрастать: строки списка берутся из записей по порядку
+    bool ok = true;
+    qint32 previous = 0;
+    for (quint32 i = 0; ok && i < header.book_count; ++i) {
+        const BookRecord record = book_record(data, qint32(i));
+        ok = record.book_id > previous
+            && in_bounds(record.title, header.strings_size)
+            && in_bounds(record.author, header.strings_size)
+            && in_bounds(record.category, header.strings_size);
+        previous = record.book_id;
+    }
+    previous = 0;
+    for (quint32 i = 0; ok && i < header.user_count; ++i) {
+        const UserRecord record = user_record(data, header.book_count, qint32(i));
+        ok = record.user_id > previous
+            && in_bounds(record.card_number, header.strings_size)
+            && in_bounds(record.name, header.strings_size);
+        previous = record.user_id;
+    }
+    if (!ok) {
+        LOG_WARNING("catalog_load").message("файл кеша каталога поврежден");
+        file_.unmap(const_cast<uchar *>(data));
+        file_.close();
+        return false;
+    }
+
+    data_ = data;
+    file_books_ = header.book_count;
+    file_users_ = header.user_count;
+    synced_at_ms_ = header.synced_at_ms;
+    rebuild_rows();
+    return true;
+}
+
+/**
+ * @brief Сохраняет снимок и отображает записанный файл
+ * @param path Путь к файлу
+ * @return true если файл записан
+ * @note Пустой снимок (база ни разу не была доступна) не сохраняется,
+ * чтобы не затереть предыдущий файл. Строки из файла переносятся байтами,
+ * без декодирования
+ */
+bool CatalogCache::save(const QString &path)
+{
+    TRACE_SPAN("CatalogCache::save");
+    if (synced_at_ms_ == 0) {
+        return false;
+    }
+
+    QByteArray body;
+    FileHeader header = {};
+    {
+        const uchar *fileStrings = data_ ? strings_begin(data_, file_books_, file_users_) : nullptr;
+        const auto raw = [fileStrings](const StringRef &ref) {
+            return QByteArray::fromRawData(reinterpret_cast<const char *>(fileStrings + ref.offset), int(ref.size));
+        };
+
+        StringTable strings;
+        std::vector<BookRecord> bookRecords;
+        bookRecords.reserve(book_rows_.size());
+        for (const Row &row : book_rows_) {
+            const auto change = book_changes_.find(row.id);
+            if (change != book_changes_.end()) {
+                const Book &book = change->second;
+                bookRecords.push_back({row.id, book.availability_count, strings.add(book.title.toUtf8()),
+                                       strings.add(book.author.toUtf8()), strings.add(book.category.toUtf8())});
+            } else {
+                const BookRecord record = book_record(data_, row.record);
+                bookRecords.push_back({row.id, record.availability_count, strings.add(raw(record.title)),
+                                       strings.add(raw(record.author)), strings.add(raw(record.category))});
+            }
+        }
+        std::vector<UserRecord> userRecords;
+        userRecords.reserve(user_rows_.size());
+        for (const Row &row : user_rows_) {
+            const auto change = user_changes_.find(row.id);
+            if (change != user_changes_.end()) {
+                userRecords.push_back({row.id, strings.add(change->second.card_number.toUtf8()),
+                                       strings.add(change->second.name.toUtf8())});
+            } else {
+                const UserRecord record = user_record(data_, file_books_, row.record);
+                userRecords.push_back({row.id, strings.add(raw(record.card_number)),
+                                       strings.add(raw(record.name))});
+            }
+        }
+
+        body.reserve(int(bookRecords.size() * sizeof(BookRecord) + userRecords.size() * sizeof(UserRecord))
+                     + strings.data().size());
+        body.append(reinterpret_cast<const char *>(bookRecords.data()), int(bookRecords.size() * sizeof(BookRecord)));
+        body.append(reinterpret_cast<const char *>(userRecords.data()), int(userRecords.size() * sizeof(UserRecord)));
+        body.append(strings.data());
+
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.byte_order = kByteOrderMark;
+        header.header_size = sizeof(FileHeader);
+        header.book_count = quint32(bookRecords.size());
+        header.user_count = quint32(userRecords.size());
+        header.strings_offset = sizeof(FileHeader) + quint64(body.size() - strings.data().size());
+        header.strings_size = quint64(strings.data().size());
+        header.synced_at_ms = synced_at_ms_;
+        header.checksum = fnv1a(reinterpret_cast<const uchar *>(body.constData()), body.size());
+    }
+
+    // Отображенный файл нельзя заменить (Windows), поэтому он закрывается до записи
+    clear();
+    QSaveFile file(path);
+    if (!file.open(QFile::WriteOnly)
+        || file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != qint64(sizeof(header))
+        || file.write(body) != body.size()
+        || !file.commit()) {
+        LOG_ERROR("catalog_save").message("не удалось записать файл кеша каталога");
+        load(path);
+        return false;
+    }
+    load(path);
+    return true;
+}
+
+/**
+ * @brief Дополняет снимок изменениями из базы
+ * @param library Подключенная библиотека
+ * @param validate Сверить количество строк с базой
+ * @return true если снимок актуален
+ * @note Если снимка нет или журнал удалений уже не покрывает время с
+ * прошлой дельты, снимок загружается целиком (дельта от нуля)
+ */
+bool CatalogCache::sync(Library *library, bool validate)
+{
+    TRACE_SPAN("CatalogCache::sync");
+    auto clock = library->read<stmt::CatalogClock>();
+    if (!clock.next()) {
+        LOG_WARNING("catalog_sync").sql(clock.error()).message("ошибка чтения времени сервера");
+        return false;
+    }
+    const qint64 now = clock.row().now_ms;
+    // Реплика может не содержать строк, зафиксированных за допустимое
+    // отставание до ее времени now(), поэтому запас увеличивается на него
+    const qint64 overlap = kOverlapMs + library->max_staleness_ms();
+
+    if (synced_at_ms_ == 0 || now - synced_at_ms_ + overlap > kRetentionMs) {
+        clear();
+    }
+    const qint64 since = synced_at_ms_ == 0 ? 0 : synced_at_ms_ - overlap;
+    bool ok = apply_delta(library, since);
+    rebuild_rows();
+
+    if (ok && validate && since != 0) {
+        auto counts = library->read<stmt::CatalogCounts>();
+        if (!counts.next()) {
+            LOG_WARNING("catalog_sync").sql(counts.error()).message("ошибка проверки кеша каталога");
+            return false;
+        }
+        const auto row = counts.row();
+        if (row.books != book_count() || row.users != user_count()) {
+            LOG_WARNING("catalog_sync").message("кеш каталога расходится с базой, полная загрузка");
+            clear();
+            ok = apply_delta(library, 0);
+            rebuild_rows();
+        }
+    }
+    if (!ok) {
+        return false;
+    }
+
+    synced_at_ms_ = now;
+    return true;
+}
+
+/**
+ * @brief Загружает изменения после since_ms
+ * @param library Подключенная библиотека
+ * @param since_ms Момент (мс с эпохи Unix), 0 — все строки
+ * @return true при успехе
+ * @note Изменения попадают в дельту поверх файла; строки, попавшие в
+ * запас kOverlapMs повторно, просто перезаписываются. Порядок строк
+ * после вызова нужно перестроить (rebuild_rows)
+ */
+bool CatalogCache::apply_delta(Library *library, qint64 since_ms)
+{
+    const auto applyBooks = [this](auto &books) {
+        if (!books.ok()) {
+            LOG_WARNING("catalog_sync").sql(books.error()).message("ошибка чтения изменений книг");
+            return false;
+        }
+        while (books.next()) {
+            const auto row = books.row();
+            book_changes_[row.book_id] = {row.title, row.author, row.category, row.availability_count};
+            deleted_books_.erase(row.book_id);
+        }
+        return true;
+    };
+    // Полная загрузка и дельта книг планируются по-разному (см. CatalogBooksSince)
+    if (since_ms == 0) {
+        auto books = library->read<stmt::CatalogBooks>();
+        if (!applyBooks(books)) {
+            return false;
+        }
+    } else {
+        auto books = library->read<stmt::CatalogBooksSince>(since_ms);
+        if (!applyBooks(books)) {
+            return false;
+        }
+    }
+
+    auto users = library->read<stmt::CatalogUsersSince>(since_ms);
+    if (!users.ok()) {
+        LOG_WARNING("catalog_sync").sql(users.error()).message("ошибка чтения изменений пользователей");
+        return false;
+    }
+    while (users.next()) {
+        const auto row = users.row();
+        user_changes_[row.user_id] = {row.card_number, row.name};
+        deleted_users_.erase(row.user_id);
+    }
+
+    if (since_ms == 0) {
+        return true;
+    }
+    auto deletions = library->read<stmt::CatalogDeletionsSince>(since_ms);
+    if (!deletions.ok()) {
+        LOG_WARNING("catalog_sync").sql(deletions.error()).message("ошибка чтения журнала удалений");
+        return false;
+    }
+    while (deletions.next()) {
+        const auto row = deletions.row();
+        if (row.table_name == "books") {
+            book_changes_.erase(row.row_id);
+            deleted_books_.insert(row.row_id);
+        } else if (row.table_name == "users") {
+            user_changes_.erase(row.row_id);
+            deleted_users_.insert(row.row_id);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Книга по номеру строки
+ * @param row Номер строки в [0, book_count())
+ * @return Книга из дельты или из записи файла (строки декодируются здесь)
+ */
+CatalogCache::Book CatalogCache::book(int row) const
+{
+    const Row &entry = book_rows_[std::size_t(row)];
+    const auto change = book_changes_.find(entry.id);
+    if (change != book_changes_.end()) {
+        return change->second;
+    }
+    const BookRecord record = book_record(data_, entry.record);
+    return {string_at(record.title.offset, record.title.size),
+            string_at(record.author.offset, record.author.size),
+            string_at(record.category.offset, record.category.size),
+            record.availability_count};
+}
+
+/**
+ * @brief Пользователь по номеру строки
+ * @param row Номер строки в [0, user_count())
+ * @return Пользователь из дельты или из записи файла
+ */
+CatalogCache::User CatalogCache::user(int row) const
+{
+    const Row &entry = user_rows_[std::size_t(row)];
+    const auto change = user_changes_.find(entry.id);
+    if (change != user_changes_.end()) {
+        return change->second;
+    }
+    const UserRecord record = user_record(data_, file_books_, entry.record);
+    return {string_at(record.card_number.offset, record.card_number.size),
+            string_at(record.name.offset, record.name.size)};
+}
+
+/**
+ * @brief Закрывает отображение файла и очищает дельту
+ */
+void CatalogCache::clear()
+{
+    if (data_) {
+        file_.unmap(const_cast<uchar *>(data_));
+        data_ = nullptr;
+    }
+    file_.close();
+    file_books_ = 0;
+    file_users_ = 0;
+    book_changes_.clear();
+    user_changes_.clear();
+    deleted_books_.clear();
+    deleted_users_.clear();
+    book_rows_.clear();
+    user_rows_.clear();
+    synced_at_ms_ = 0;
+}
+
+/**
+ * @brief Перестраивает порядок строк: записи файла без удаленных плюс дельта
+ */
+void CatalogCache::rebuild_rows()
+{
+    const uchar *data = data_;
+    const quint32 books = file_books_;
+    merge_rows(file_books_, [data](qint32 i) { return book_record(data, i).book_id; },
+               book_changes_, deleted_books_, &book_rows_);
+    merge_rows(file_users_, [data, books](qint32 i) { return user_record(data, books, i).user_id; },
+               user_changes_, deleted_users_, &user_rows_);
+}
+
+/**
+ * @brief Декодирует строку из таблицы строк файла
+ * @param offset Смещение от начала таблицы строк
+ * @param size Длина в байтах UTF-8
+ */
+QString CatalogCache::string_at(quint32 offset, quint32 size) const
+{
+    const uchar *strings = strings_begin(data_, file_books_, file_users_);
+    return QString::fromUtf8(reinterpret_cast<const char *>(strings + offset), int(size));
+}
@@ -0,0 +1,151 @@
+#ifndef CATALOGCACHE_H
+#define CATALOGCACHE_H
+
+#include <QFile>
+#include <QString>
+#include <QtGlobal>
+#include <map>
+#include <set>
+#include <vector>
+
+class Library;
+
+/**
+ * @brief Локальный снимок каталога книг и списка пользователей
+ *
+ * При выходе снимок сохраняется в двоичный файл: заголовок с версией,
+ * массивы записей фиксированной длины и таблица строк UTF-8 (одинаковые
+ * строки, например авторы и категории, хранятся один раз). При запуске
+ * файл отображается в память и проверяется, но не разбирается: записи
+ * читаются прямо из отображения, а строки декодируются только для
+ * показанных строк таблицы (см. CatalogModel), поэтому списки доступны
+ * сразу и до подключения к базе. После подключения снимок дополняется
+ * дельтой: строками, измененными после сохраненного момента (updated_at),
+ * и журналом удалений (catalog_deletions). Дельта хранится отдельно,
+ * поверх отображенных записей.
+ */
+class CatalogCache {
+public:
+    static constexpr quint32 kVersion = 1;             ///< Версия формата файла
+    static constexpr qint64 kOverlapMs = 60 * 1000;    ///< Запас на транзакции, начатые до прошлой дельты (к нему добавляется отставание реплики)
+    static constexpr qint64 kRetentionMs = 30LL * 24 * 3600 * 1000; ///< Срок хранения журнала удалений
+
+    /**
+     * @brief Книга в снимке
+     */
+    struct Book {
+        QString title;
+        QString author;
+        QString category;
+        int availability_count = 0;
+    };
+
+    /**
+     * @brief Пользователь в снимке
+     */
+    struct User {
+        QString card_number;
+        QString name;
+    };
+
+    CatalogCache() = default;
+    ~CatalogCache();
+
+    CatalogCache(const CatalogCache&) = delete;
+    CatalogCache& operator=(const CatalogCache&) = delete;
+
+    /**
+     * @brief Путь к файлу снимка
+     * @return LIBRARY_CATALOG_CACHE или "catalog.cache" в рабочем каталоге
+     */
+    static QString default_path();
+
+    /**
+     * @brief Отображает снимок из файла в память
+     * @param path Путь к файлу
+     * @return true если файл прочитан; при отсутствии, другой версии или
+     *         повреждении снимок остается пустым и будет загружен целиком
+     */
+    bool load(const QString& path);
+
+    /**
+     * @brief Сохраняет снимок (атомарной заменой файла) и отображает записанный файл
+     * @param path Путь к файлу
+     * @return true если файл записан
+     * @note Отображение снимаемого файла закрывается до замены; если запись
+     * не удалась, снимок заново читается из прежнего файла (дельта
+     * загрузится при следующей синхронизации)
+     */
+    bool save(const QString& path);
+
+    /**
+     * @brief Дополняет снимок изменениями из базы
+     * @param library Подключенная библиотека (чтение через Library::read)
+     * @param validate Сверить количество книг и пользователей с базой и
+     *        при расхождении загрузить снимок заново
+     * @return true если снимок актуален
+     */
+    bool sync(Library* library, bool validate);
+
+    /// @brief Количество книг
+    int book_count() const { return int(book_rows_.size()); }
+
+    /// @brief Количество пользователей
+    int user_count() const { return int(user_rows_.size()); }
+
+    /**
+     * @brief Книга по номеру строки (по возрастанию book_id)
+     * @param row Номер строки в [0, book_count())
+     */
+    Book book(int row) const;
+
+    /**
+     * @brief Пользователь по номеру строки (по возрастанию user_id)
+     * @param row Номер строки в [0, user_count())
+     */
+    User user(int row) const;
+
+private:
+    /**
+     * @brief Строка списка: ключ и запись в отображенном файле
+     */
+    struct Row {
+        qint32 id;      ///< book_id или user_id
+        qint32 record;  ///< Номер записи в файле или -1, если строка есть только в дельте
+    };
+
+    /**
+     * @brief Загружает строки, измененные после since_ms, и удаления
+     * @return true при успехе
+     */
+    bool apply_delta(Library* library, qint64 since_ms);
+
+    /**
+     * @brief Закрывает отображение и очищает дельту
+     */
+    void clear();
+
+    /**
+     * @brief Перестраивает порядок строк после изменения дельты
+     */
+    void rebuild_rows();
+
+    /**
+     * @brief Декодирует строку из таблицы строк файла
+     */
+    QString string_at(quint32 offset, quint32 size) const;
+
+    QFile file_;                           ///< Файл снимка (открыт, пока отображен)
+    const uchar *data_ = nullptr;          ///< Отображение файла или nullptr
+    quint32 file_books_ = 0;               ///< Количество записей книг в файле
+    quint32 file_users_ = 0;               ///< Количество записей пользователей в файле
+    std::map<int, Book> book_changes_;     ///< Книги из дельты по book_id
+    std::map<int, User> user_changes_;     ///< Пользователи из дельты по user_id
+    std::set<int> deleted_books_;          ///< Книги файла, удаленные по журналу
+    std::set<int> deleted_users_;          ///< Пользователи файла, удаленные по журналу
+    std::vector<Row> book_rows_;           ///< Книги по возрастанию book_id
+    std::vector<Row> user_rows_;           ///< Пользователи по возрастанию user_id
+    qint64 synced_at_ms_ = 0;              ///< Время сервера последней дельты (0 — снимка нет)
+};
+
+#endif // CATALOGCACHE_H
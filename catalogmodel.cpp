@@ -0,0 +1,100 @@
+#include "catalogmodel.h"
+
+/**
+ * @brief Конструктор
+ * @param catalog Снимок каталога
+ * @param parent Родительский объект
+ */
+CatalogModel::CatalogModel(CatalogCache *catalog, QObject *parent)
+    : QAbstractTableModel(parent), catalog(catalog)
+{
+}
+
+/**
+ * @brief Переключает показываемый список
+ * @param value Книги или пользователи
+ */
+void CatalogModel::show(List value)
+{
+    beginResetModel();
+    list = value;
+    endResetModel();
+}
+
+/**
+ * @brief Дополняет снимок изменениями из базы
+ * @param library Подключенная библиотека
+ * @param validate Сверить количество строк с базой
+ * @return true если снимок актуален
+ */
+bool CatalogModel::sync(Library *library, bool validate)
+{
+    beginResetModel();
+    const bool ok = catalog->sync(library, validate);
+    endResetModel();
+    return ok;
+}
+
+/**
+ * @brief Количество строк показываемого списка
+ */
+int CatalogModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return list == List::Books ? catalog->book_count() : catalog->user_count();
+}
+
+/**
+ * @brief Количество колонок показываемого списка
+ */
+int CatalogModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return list == List::Books ? 4 : 2;
+}
+
+/**
+ * @brief Значение ячейки; строки снимка декодируются здесь
+ */
+QVariant CatalogModel::data(const QModelIndex &index, int role) const
+{
+    if (role != Qt::DisplayRole || !index.isValid() || index.row() >= rowCount()) {
+        return QVariant();
+    }
+    if (list == List::Books) {
+        const CatalogCache::Book book = catalog->book(index.row());
+        switch (index.column()) {
+        case 0: return book.title;
+        case 1: return book.author;
+        case 2: return book.category;
+        case 3: return book.availability_count;
+        default: return QVariant();
+        }
+    }
+    const CatalogCache::User user = catalog->user(index.row());
+    switch (index.column()) {
+    case 0: return user.card_number;
+    case 1: return user.name;
+    default: return QVariant();
+    }
+}
+
+/**
+ * @brief Заголовки колонок
+ */
+QVariant CatalogModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    static const char *const books[] = {"Название", "Автор", "Категория", "Доступно"};
+    static const char *const users[] = {"Номер карточки", "Пользователь"};
+    if (section < 0 || section >= columnCount()) {
+        return QVariant();
+    }
+    return QString::fromUtf8(list == List::Books ? books[section] : users[section]);
+}
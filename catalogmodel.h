@@ -0,0 +1,61 @@
+#ifndef CATALOGMODEL_H
+#define CATALOGMODEL_H
+
+#include <QAbstractTableModel>
+#include "catalogcache.h"
+
+class Library;
+
+/**
+ * @brief Модель таблицы книг или пользователей поверх снимка каталога
+ *
+ * Не копирует данные: число строк берется из CatalogCache, а значения
+ * ячеек запрашиваются у него при отрисовке, поэтому строки декодируются
+ * только для видимой части списка, а не для всех записей снимка.
+ */
+class CatalogModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Показываемый список
+     */
+    enum class List {
+        Books,  ///< Книги: название, автор, категория, доступно
+        Users,  ///< Пользователи: номер карточки, имя
+    };
+
+    /**
+     * @brief Конструктор
+     * @param catalog Снимок каталога (должен жить дольше модели)
+     * @param parent Родительский объект
+     */
+    explicit CatalogModel(CatalogCache *catalog, QObject *parent = nullptr);
+
+    /**
+     * @brief Переключает показываемый список
+     * @param list Книги или пользователи
+     */
+    void show(List list);
+
+    /**
+     * @brief Дополняет снимок изменениями из базы (см. CatalogCache::sync)
+     * @note Представления сбрасываются, так как строки снимка меняются
+     */
+    bool sync(Library *library, bool validate);
+
+    /// @name QAbstractTableModel
+    /// @{
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    /// @}
+
+private:
+    CatalogCache *catalog;    ///< Снимок каталога
+    List list = List::Books;  ///< Показываемый список
+};
+
+#endif // CATALOGMODEL_H
@@ -0,0 +1,151 @@
+#include "connector.h"
+#include "logger.h"
+#include <QSocketNotifier>
+#include <QtGlobal>
+#include <libpq-fe.h>
+
+/**
+ * @brief Конструктор
+ * @param host Адрес сервера БД
+ * @param db_name Имя базы данных
+ * @param user Имя пользователя БД
+ * @param password Пароль пользователя
+ * @param parent Родительский объект
+ */
+DatabaseConnector::DatabaseConnector(const QString &host, const QString &db_name,
+                                     const QString &user, const QString &password,
+                                     QObject *parent)
+    : QObject(parent),
+      host_(host.toUtf8()),
+      db_name_(db_name.toUtf8()),
+      user_(user.toUtf8()),
+      password_(password.toUtf8())
+{
+    timeout_.setSingleShot(true);
+    retry_.setSingleShot(true);
+    connect(&timeout_, &QTimer::timeout, this, &DatabaseConnector::give_up);
+    connect(&retry_, &QTimer::timeout, this, &DatabaseConnector::start);
+}
+
+/**
+ * @brief Деструктор
+ */
+DatabaseConnector::~DatabaseConnector()
+{
+    if (conn_) {
+        PQfinish(conn_);
+    }
+}
+
+/**
+ * @brief Начинает неблокирующее подключение libpq
+ * @note Имя хоста разрешается при запуске синхронно; для localhost и
+ * адресов это мгновенно
+ */
+void DatabaseConnector::start()
+{
+    if (conn_) {
+        return;
+    }
+    retry_.stop();
+    const char *const keys[] = {"host", "dbname", "user", "password", nullptr};
+    const char *const values[] = {host_.constData(), db_name_.constData(),
+                                  user_.constData(), password_.constData(), nullptr};
+    conn_ = PQconnectStartParams(keys, values, 0);
+    if (!conn_ || PQstatus(conn_) == CONNECTION_BAD) {
+        finish(false);
+        return;
+    }
+    timeout_.start(kTimeoutMs);
+    // До первого PQconnectPoll подключение ждет готовности к записи
+    watch(false);
+}
+
+/**
+ * @brief Планирует повторную проверку
+ */
+void DatabaseConnector::retry_later()
+{
+    retry_.start(kRetryMs);
+}
+
+/**
+ * @brief Продолжает подключение после готовности сокета
+ */
+void DatabaseConnector::poll()
+{
+    if (!conn_) {
+        return;
+    }
+    switch (PQconnectPoll(conn_)) {
+    case PGRES_POLLING_OK:
+        finish(true);
+        break;
+    case PGRES_POLLING_FAILED:
+        finish(false);
+        break;
+    case PGRES_POLLING_READING:
+        watch(true);
+        break;
+    default:
+        watch(false);
+        break;
+    }
+}
+
+/**
+ * @brief Прерывает проверку, не завершившуюся за kTimeoutMs
+ */
+void DatabaseConnector::give_up()
+{
+    finish(false);
+}
+
+/**
+ * @brief Ждет готовности сокета подключения
+ * @param read true — к чтению, false — к записи
+ * @note Сокет может меняться между попытками (например, при переборе
+ * адресов хоста), поэтому наблюдатель создается заново на каждом шаге
+ */
+void DatabaseConnector::watch(bool read)
+{
+    if (notifier_) {
+        // Вызывается из сигнала этого наблюдателя, поэтому удаление откладывается
+        notifier_->setEnabled(false);
+        notifier_->deleteLater();
+    }
+    notifier_ = new QSocketNotifier(PQsocket(conn_),
+                                    read ? QSocketNotifier::Read : QSocketNotifier::Write, this);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    connect(notifier_, &QSocketNotifier::activated, this, &DatabaseConnector::poll);
+#else
+    connect(notifier_, SIGNAL(activated(int)), this, SLOT(poll()));
+#endif
+}
+
+/**
+ * @brief Закрывает проверочное подключение и сообщает результат
+ * @param ok true если сервер принял подключение
+ */
+void DatabaseConnector::finish(bool ok)
+{
+    timeout_.stop();
+    if (notifier_) {
+        notifier_->setEnabled(false);
+        notifier_->deleteLater();
+        notifier_ = nullptr;
+    }
+    if (!ok) {
+        LOG_WARNING("connect").message("нет подключения к базе данных, повтор позже");
+    }
+    if (conn_) {
+        PQfinish(conn_);
+        conn_ = nullptr;
+    }
+    if (ok) {
+        emit reachable();
+    } else {
+        retry_later();
+        emit unreachable();
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef CONNECTOR_H
+#define CONNECTOR_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class QSocketNotifier;
+typedef struct pg_conn PGconn;
+
+/**
+ * @brief Неблокирующая проверка доступности сервера PostgreSQL
+ *
+ * Подключение QPSQL открывается синхронно, и недоступный или медленный
+ * сервер задерживал бы главный поток. Поэтому сначала сервер проверяется
+ * неблокирующим подключением libpq (PQconnectStartParams/PQconnectPoll),
+ * которое опрашивается по готовности сокета из цикла событий, с
+ * ограничением kTimeoutMs. Сигнал reachable() означает, что сервер принял
+ * подключение с этими учетными данными и подключение QPSQL откроется
+ * быстро; при неудаче проверка повторяется через kRetryMs.
+ *
+ * Проверочное подключение закрывается: драйвер QPSQL не может принять
+ * готовое подключение libpq без закрытых заголовков Qt.
+ */
+class DatabaseConnector : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kTimeoutMs = 5000;  ///< Предельная длительность проверки
+    static constexpr int kRetryMs = 15000;   ///< Пауза перед повторной проверкой
+
+    /**
+     * @brief Конструктор
+     * @param host Адрес сервера БД
+     * @param db_name Имя базы данных
+     * @param user Имя пользователя БД
+     * @param password Пароль пользователя
+     * @param parent Родительский объект
+     */
+    DatabaseConnector(const QString& host, const QString& db_name,
+                      const QString& user, const QString& password,
+                      QObject *parent = nullptr);
+
+    /**
+     * @brief Деструктор; прерывает незавершенную проверку
+     */
+    ~DatabaseConnector() override;
+
+    /**
+     * @brief Начинает проверку (не блокирует)
+     */
+    void start();
+
+    /**
+     * @brief Планирует повторную проверку через kRetryMs
+     * @note Вызывается и снаружи, если сервер принял проверку, а
+     * подключение QPSQL все же не открылось
+     */
+    void retry_later();
+
+signals:
+    /// @brief Сервер принял подключение
+    void reachable();
+
+    /// @brief Сервер недоступен; повторная проверка уже запланирована
+    void unreachable();
+
+private slots:
+    /// @brief Продолжает подключение, когда сокет готов
+    void poll();
+
+    /// @brief Прерывает проверку по истечении kTimeoutMs
+    void give_up();
+
+private:
+    /**
+     * @brief Ждет готовности сокета к чтению или записи
+     */
+    void watch(bool read);
+
+    /**
+     * @brief Завершает проверку и сообщает результат
+     */
+    void finish(bool ok);
+
+    QByteArray host_;                     ///< Адрес сервера БД
+    QByteArray db_name_;                  ///< Имя базы данных
+    QByteArray user_;                     ///< Имя пользователя БД
+    QByteArray password_;                 ///< Пароль пользователя
+    PGconn *conn_ = nullptr;              ///< Проверочное подключение (nullptr вне проверки)
+    QSocketNotifier *notifier_ = nullptr; ///< Ожидание готовности сокета
+    QTimer timeout_;                      ///< Ограничение длительности проверки
+    QTimer retry_;                        ///< Повторная проверка
+};
+
+#endif // CONNECTOR_H
@@ -0,0 +1,67 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <QStringList>
+#include <QTextStream>
+#include "library.h"
+
+/**
+ * @brief Консольный (безоконный) режим приложения
+ *
+ * Выполняет служебные задачи без графического интерфейса, например
+ * из планировщика заданий:
+ * - `migrate` — применить миграции схемы
+ * - `overdue [ГГГГ-ММ-ДД] [--bench N]` — ночной расчет просрочек
+ * - `overdue-report` — вывести отчет о просрочках
+ * - `plan-check [--baselines ФАЙЛ] [--update]` — проверить планы запросов
+ * - `generate [--seed N] [--scale K] [--books N] [--users N] [--loans N] [--today ГГГГ-ММ-ДД]` —
+ *   заполнить пустую базу синтетическими данными
+ * - `reconcile [--repair] [--chunk N] [--threads N]` — сверить счетчики
+ *   доступных экземпляров с выдачами
+ */
+class Console {
+public:
+    /**
+     * @brief Конструктор
+     * @param lib Указатель на подключенный объект Library (не может быть nullptr)
+     */
+    explicit Console(Library *lib);
+
+    /**
+     * @brief Является ли аргумент командой консольного режима
+     * @param name Первый аргумент командной строки
+     * @note Остальные аргументы (например, -style, -platform) относятся к
+     * графическому режиму и передаются QApplication
+     */
+    static bool is_command(const QString& name);
+
+    /**
+     * @brief Выполняет команду
+     * @param args Аргументы командной строки без имени программы
+     * @return Код возврата процесса (0 при успехе)
+     */
+    int run(const QStringList& args);
+
+private:
+    /// @name Команды
+    /// @{
+    int migrate();
+    int overdue(const QStringList& args);
+    int overdue_report();
+    int plan_check(const QStringList& args);
+    int generate(const QStringList& args);
+    int reconcile(const QStringList& args);
+    /// @}
+
+    /**
+     * @brief Выводит справку по командам
+     * @return Код возврата для неизвестной команды
+     */
+    int usage();
+
+    Library *library;  ///< Указатель на объект работы с библиотекой
+    QTextStream out;   ///< Стандартный вывод
+    QTextStream err;   ///< Стандартный поток ошибок
+};
+
+#endif // CONSOLE_H
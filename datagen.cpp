@@ -0,0 +1,593 @@
+#include "datagen.h"
+#include "schema.h"
+#include "logger.h"
+#include "tracer.h"
+#include <QByteArray>
+#include <QDate>
+#include <QElapsedTimer>
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+#include <libpq-fe.h>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <vector>
+
+namespace {
+
+/// @name Словари (UTF-8)
+/// @{
+const char *const kCategories[] = {
+    "Роман", "Детектив", "Фантастика", "Фэнтези", "Поэзия", "История",
+    "Биография", "Психология", "Детская литература", "Приключения",
+    "Научно-популярная", "Классика", "Драматургия", "Философия",
+    "Учебная литература", "Справочники",
+};
+
+const char *const kMaleNames[] = {
+    "Александр", "Алексей", "Андрей", "Борис", "Вадим", "Василий", "Виктор",
+    "Владимир", "Дмитрий", "Евгений", "Иван", "Игорь", "Илья", "Кирилл",
+    "Константин", "Максим", "Михаил", "Николай", "Олег", "Павел", "Пётр",
+    "Роман", "Сергей", "Степан", "Тимофей", "Фёдор", "Юрий", "Ярослав",
+};
+
+const char *const kFemaleNames[] = {
+    "Алина", "Анастасия", "Анна", "Валентина", "Вера", "Дарья", "Екатерина",
+    "Елена", "Ирина", "Кира", "Ксения", "Лариса", "Любовь", "Людмила",
+    "Марина", "Мария", "Надежда", "Наталья", "Ольга", "Полина", "Светлана",
+    "Софья", "Татьяна", "Ульяна", "Юлия", "Яна",
+};
+
+/// Отчества [мужское, женское] в порядке kMaleNames
+const char *const kPatronymics[][2] = {
+    {"Александрович", "Александровна"}, {"Алексеевич", "Алексеевна"},
+    {"Андреевич", "Андреевна"}, {"Борисович", "Борисовна"}, {"Вадимович", "Вадимовна"},
+    {"Васильевич", "Васильевна"}, {"Викторович", "Викторовна"},
+    {"Владимирович", "Владимировна"}, {"Дмитриевич", "Дмитриевна"},
+    {"Евгеньевич", "Евгеньевна"}, {"Иванович", "Ивановна"}, {"Игоревич", "Игоревна"},
+    {"Ильич", "Ильинична"}, {"Кириллович", "Кирилловна"},
+    {"Константинович", "Константиновна"}, {"Максимович", "Максимовна"},
+    {"Михайлович", "Михайловна"}, {"Николаевич", "Николаевна"}, {"Олегович", "Олеговна"},
+    {"Павлович", "Павловна"}, {"Петрович", "Петровна"}, {"Романович", "Романовна"},
+    {"Сергеевич", "Сергеевна"}, {"Степанович", "Степановна"},
+    {"Тимофеевич", "Тимофеевна"}, {"Фёдорович", "Фёдоровна"}, {"Юрьевич", "Юрьевна"},
+    {"Ярославович", "Ярославовна"},
+};
+
+/// Фамилии в мужской форме; женская образуется окончанием «а»
+const char *const kLastNames[] = {
+    "Иванов", "Смирнов", "Кузнецов", "Попов", "Васильев", "Петров", "Соколов",
+    "Михайлов", "Новиков", "Фёдоров", "Морозов", "Волков", "Алексеев",
+    "Лебедев", "Семёнов", "Егоров", "Павлов", "Козлов", "Степанов", "Николаев",
+    "Орлов", "Андреев", "Макаров", "Никитин", "Захаров", "Зайцев", "Соловьёв",
+    "Борисов", "Яковлев", "Григорьев", "Романов", "Воробьёв", "Сергеев",
+    "Кузьмин", "Фролов", "Александров", "Дмитриев", "Королёв", "Гусев",
+    "Киселёв", "Ильин", "Максимов", "Поляков", "Сорокин", "Виноградов",
+    "Ковалёв", "Белов", "Медведев", "Антонов", "Тарасов", "Жуков", "Баранов",
+    "Филиппов", "Комаров", "Давыдов", "Беляев", "Герасимов", "Богданов",
+    "Осипов", "Сидоров", "Матвеев", "Титов", "Марков", "Миронов", "Крылов",
+    "Куликов", "Карпов", "Власов", "Мельников", "Денисов", "Гаврилов",
+    "Тихонов", "Казаков", "Афанасьев", "Данилов", "Савельев", "Тимофеев",
+    "Фомин", "Чернов", "Абрамов", "Мартынов", "Ефимов", "Федотов", "Щербаков",
+};
+
+const char *const kTitleHeads[] = {
+    "Тайна", "Песнь", "Хроники", "Дом", "Сад", "Путь", "Тень", "Город",
+    "История", "Сказание", "Письма", "Записки", "Легенда", "Возвращение",
+    "Дорога", "Голос", "Свет", "Остров", "Память", "Последний день",
+};
+
+const char *const kTitleTails[] = {
+    "старого моста", "северного ветра", "забытого города", "последнего лета",
+    "белой ночи", "тихой реки", "серебряного леса", "далёкой звезды",
+    "зимнего сада", "морского берега", "пустого дома", "утреннего поезда",
+    "чужой земли", "первой любви", "горного перевала", "осеннего дождя",
+    "красной площади", "волжского края", "потерянного времени", "старой усадьбы",
+};
+/// @}
+
+/**
+ * @brief Генератор псевдослучайных чисел SplitMix64
+ *
+ * Стандартные распределения (std::uniform_int_distribution и др.)
+ * реализованы в разных библиотеках по-разному, поэтому для
+ * воспроизводимости набора значения выводятся вручную.
+ */
+class Random {
+public:
+    explicit Random(quint64 seed) : state_(seed) {}
+
+    quint64 next()
+    {
+        quint64 z = (state_ += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    /// @brief Равномерно в [0, n)
+    int below(int n) { return int(next() % quint64(n)); }
+
+    /// @brief Равномерно в [0, 1)
+    double real() { return double(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    quint64 state_;
+};
+
+/**
+ * @brief Выбор по закону Ципфа среди n элементов
+ *
+ * Ранги переставлены случайно, чтобы популярные элементы не совпадали
+ * с наименьшими идентификаторами.
+ */
+class Zipf {
+public:
+    Zipf(int n, double exponent, Random &random)
+        : cdf_(std::size_t(n)), ids_(std::size_t(n))
+    {
+        double sum = 0;
+        for (int rank = 0; rank < n; ++rank) {
+            sum += 1.0 / std::pow(rank + 1, exponent);
+            cdf_[std::size_t(rank)] = sum;
+        }
+        for (double &value : cdf_) {
+            value /= sum;
+        }
+        for (int i = 0; i < n; ++i) {
+            ids_[std::size_t(i)] = i + 1;
+        }
+        for (int i = n - 1; i > 0; --i) {
+            std::swap(ids_[std::size_t(i)], ids_[std::size_t(random.below(i + 1))]);
+        }
+    }
+
+    /// @brief Идентификатор (1..n)
+    int sample(Random &random) const
+    {
+        const auto it = std::lower_bound(cdf_.begin(), cdf_.end(), random.real());
+        const std::size_t rank = std::min<std::size_t>(std::size_t(it - cdf_.begin()), ids_.size() - 1);
+        return ids_[rank];
+    }
+
+private:
+    std::vector<double> cdf_;  ///< Накопленные вероятности рангов
+    std::vector<int> ids_;     ///< Идентификатор для каждого ранга
+};
+
+/**
+ * @brief Выдача до загрузки
+ */
+struct Loan {
+    int book_id;
+    int user_id;
+    int loan_day;    ///< Юлианский день выдачи
+    int return_day;  ///< Юлианский день возврата или -1
+};
+
+/**
+ * @brief Потоковая загрузка одной таблицы командой COPY в текстовом формате
+ */
+class CopyStream {
+public:
+    static constexpr int kFlushBytes = 1 << 20;  ///< Размер порции, передаваемой серверу
+
+    explicit CopyStream(PGconn *conn) : conn_(conn) { buffer_.reserve(kFlushBytes + 4096); }
+
+    /**
+     * @brief Начинает COPY
+     * @param target Таблица и список колонок, например "users (user_id, ...)"
+     */
+    bool begin(const char *target)
+    {
+        PGresult *result = PQexec(conn_, QByteArray("COPY ").append(target).append(" FROM STDIN").constData());
+        active_ = PQresultStatus(result) == PGRES_COPY_IN;
+        PQclear(result);
+        buffer_.clear();
+        first_ = true;
+        rows_ = 0;
+        return active_;
+    }
+
+    CopyStream &field(int value)
+    {
+        separator();
+        buffer_ += QByteArray::number(value);
+        return *this;
+    }
+
+    CopyStream &field(const char *utf8)
+    {
+        separator();
+        buffer_ += utf8;
+        return *this;
+    }
+
+    CopyStream &field(const QByteArray &utf8)
+    {
+        separator();
+        buffer_ += utf8;
+        return *this;
+    }
+
+    CopyStream &null()
+    {
+        separator();
+        buffer_ += "\\N";
+        return *this;
+    }
+
+    /// @brief Завершает строку; передает буфер серверу, когда он заполнен
+    bool end_row()
+    {
+        buffer_ += '\n';
+        first_ = true;
+        ++rows_;
+        return buffer_.size() < kFlushBytes || flush();
+    }
+
+    /// @brief Завершает COPY и проверяет результат
+    bool finish()
+    {
+        if (!flush()) {
+            return false;
+        }
+        return end(nullptr);
+    }
+
+    /// @brief Прерывает незавершенный COPY, чтобы транзакцию можно было откатить
+    void abort()
+    {
+        if (active_) {
+            end("загрузка прервана");
+        }
+    }
+
+    qint64 rows() const { return rows_; }
+
+private:
+    bool end(const char *error)
+    {
+        active_ = false;
+        if (PQputCopyEnd(conn_, error) != 1) {
+            return false;
+        }
+        bool ok = true;
+        while (PGresult *result = PQgetResult(conn_)) {
+            ok = ok && PQresultStatus(result) == PGRES_COMMAND_OK;
+            PQclear(result);
+        }
+        return ok;
+    }
+
+    void separator()
+    {
+        if (!first_) {
+            buffer_ += '\t';
+        }
+        first_ = false;
+    }
+
+    bool flush()
+    {
+        const bool ok = buffer_.isEmpty() || PQputCopyData(conn_, buffer_.constData(), int(buffer_.size())) == 1;
+        buffer_.clear();
+        return ok;
+    }
+
+    PGconn *conn_;
+    QByteArray buffer_;
+    bool first_ = true;
+    bool active_ = false;
+    qint64 rows_ = 0;
+};
+
+template <typename T, std::size_t N>
+const char *pick(const T (&words)[N], Random &random)
+{
+    return words[random.below(int(N))];
+}
+
+/**
+ * @brief Полное имя: [имя, фамилия] с согласованием фамилии по роду
+ */
+void person(Random &random, QByteArray *first_name, QByteArray *last_name)
+{
+    const bool female = random.below(2) == 0;
+    *first_name = female ? pick(kFemaleNames, random) : pick(kMaleNames, random);
+    *last_name = pick(kLastNames, random);
+    if (female) {
+        last_name->append("а");
+    }
+}
+
+/// Количество различных полных имен авторов (см. author_name)
+constexpr int kAuthorNames = int((std::size(kMaleNames) + std::size(kFemaleNames))
+                                 * (std::size(kPatronymics) + 1) * std::size(kLastNames));
+
+/**
+ * @brief Полное имя автора по номеру сочетания
+ * @param index Номер в [0, kAuthorNames): имя, отчество (или без него) и фамилия
+ *
+ * Книги ищутся по полному имени автора ("Имя Фамилия"), поэтому у
+ * разных авторов оно не должно совпадать. Отчество входит в first_name,
+ * как «Анна Сергеевна»; фамилия не содержит пробелов, поэтому разные
+ * номера дают разные строки first_name || ' ' || last_name.
+ */
+void author_name(int index, QByteArray *first_name, QByteArray *last_name)
+{
+    const int lastNames = int(std::size(kLastNames));
+    const int patronymics = int(std::size(kPatronymics)) + 1;
+    const int maleNames = int(std::size(kMaleNames));
+    *last_name = kLastNames[index % lastNames];
+    index /= lastNames;
+    const int patronymic = index % patronymics - 1;
+    index /= patronymics;
+    const bool female = index >= maleNames;
+    *first_name = female ? kFemaleNames[index - maleNames] : kMaleNames[index];
+    if (patronymic >= 0) {
+        first_name->append(' ').append(kPatronymics[patronymic][female ? 1 : 0]);
+    }
+    if (female) {
+        last_name->append("а");
+    }
+}
+
+/**
+ * @brief Ошибка libpq в виде QSqlError для журнала
+ */
+QSqlError copy_error(PGconn *conn)
+{
+    return QSqlError(QStringLiteral("COPY"), QString::fromUtf8(PQerrorMessage(conn)), QSqlError::StatementError);
+}
+
+} // namespace
+
+/**
+ * @brief Размеры по умолчанию, умноженные на scale
+ * @param scale Множитель размеров
+ * @return Настройки
+ */
+DatasetGenerator::Config DatasetGenerator::Config::scaled(double scale)
+{
+    Config config;
+    config.authors = std::max(1, int(config.authors * scale));
+    config.books = std::max(1, int(config.books * scale));
+    config.users = std::max(1, int(config.users * scale));
+    config.loans = std::max(1, int(config.loans * scale));
+    return config;
+}
+
+/**
+ * @brief Конструктор
+ * @param db Подключение к базе данных
+ * @param config Размер и параметры набора
+ */
+DatasetGenerator::DatasetGenerator(const QSqlDatabase &db, const Config &config)
+    : db_(db), config_(config)
+{
+}
+
+/**
+ * @brief Генерирует и загружает набор данных
+ * @param stats Итоги загрузки (может быть nullptr)
+ * @return true при успехе
+ * @note Выполняет следующие действия:
+ * 1. Применяет миграции, чтобы триггер и таблицы статистики существовали
+ * 2. Проверяет, что таблицы данных пусты
+ * 3. Строит выдачи в памяти: счетчики доступных экземпляров книг
+ *    должны быть известны до загрузки книг
+ * 4. Загружает таблицы через COPY в одной транзакции с отключенным
+ *    триггером статистики и выравнивает последовательности ключей
+ * 5. Заполняет статистику повторной миграцией и обновляет ANALYZE
+ */
+bool DatasetGenerator::run(Stats *stats)
+{
+    TRACE_SPAN("DatasetGenerator::run");
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!Schema::migrate(db_)) {
+        return false;
+    }
+
+    QSqlQuery query(db_);
+    if (!query.exec("SELECT EXISTS (SELECT 1 FROM authors) OR EXISTS (SELECT 1 FROM categories) "
+                    "OR EXISTS (SELECT 1 FROM books) OR EXISTS (SELECT 1 FROM users) "
+                    "OR EXISTS (SELECT 1 FROM book_loans)")
+        || !query.next()) {
+        LOG_ERROR("generate").sql(query.lastError()).message("ошибка проверки таблиц");
+        return false;
+    }
+    if (query.value(0).toBool()) {
+        LOG_ERROR("generate").message("таблицы не пусты, генерация возможна только в пустую базу");
+        return false;
+    }
+
+    const QVariant handle = db_.driver()->handle();
+    if (!handle.isValid() || qstrcmp(handle.typeName(), "PGconn*") != 0) {
+        LOG_ERROR("generate").message("подключение не использует драйвер QPSQL");
+        return false;
+    }
+    PGconn *conn = *static_cast<PGconn *const *>(handle.constData());
+
+    const int authors = std::min(config_.authors, kAuthorNames);
+    if (authors < config_.authors) {
+        LOG_WARNING("generate").message("число авторов ограничено количеством различных полных имен");
+    }
+
+    // Выдачи и итоговые счетчики экземпляров
+    tracing::Span buildSpan("build_loans");
+    Random random(config_.seed);
+    const int categories = int(std::size(kCategories));
+    const Zipf bookPopularity(config_.books, config_.zipf, random);
+    const Zipf readerActivity(config_.users, 0.6, random);
+    const Zipf authorOutput(authors, 0.7, random);
+    const Zipf categoryShare(categories, 0.8, random);
+
+    std::vector<int> copies(std::size_t(config_.books) + 1);
+    std::vector<int> onLoan(std::size_t(config_.books) + 1, 0);
+    for (int id = 1; id <= config_.books; ++id) {
+        copies[std::size_t(id)] = 1 + random.below(5);
+    }
+
+    const int today = int((config_.today.isValid() ? config_.today : QDate::currentDate()).toJulianDay());
+    const int firstDay = today - config_.years * 365;
+    std::vector<Loan> loans(std::size_t(config_.loans));
+    for (Loan &loan : loans) {
+        loan.loan_day = firstDay + random.below(today - firstDay + 1);
+    }
+    // Номера выдач растут вместе с датой, как в рабочей базе
+    std::sort(loans.begin(), loans.end(),
+              [](const Loan &a, const Loan &b) { return a.loan_day < b.loan_day; });
+    for (Loan &loan : loans) {
+        loan.book_id = bookPopularity.sample(random);
+        loan.user_id = readerActivity.sample(random);
+        // Недавние выдачи часто еще на руках, старые — почти все возвращены
+        const bool recent = loan.loan_day > today - 45;
+        const bool open = recent ? random.real() < 0.6 : random.real() < 0.005;
+        int &out = onLoan[std::size_t(loan.book_id)];
+        if (open && out < copies[std::size_t(loan.book_id)]) {
+            loan.return_day = -1;
+            ++out;
+        } else {
+            loan.return_day = std::min(today, loan.loan_day + 1 + random.below(35));
+        }
+    }
+    buildSpan.end();
+
+    // Даты в формате ISO для всего диапазона
+    std::vector<QByteArray> dates(std::size_t(today - firstDay + 1));
+    for (int day = firstDay; day <= today; ++day) {
+        dates[std::size_t(day - firstDay)] = QDate::fromJulianDay(day).toString(Qt::ISODate).toLatin1();
+    }
+
+    if (!db_.transaction()) {
+        LOG_ERROR("generate").sql(db_.lastError()).message("ошибка начала транзакции");
+        return false;
+    }
+    // Статистика заполняется одним проходом после загрузки, а не триггером на каждую строку
+    if (!query.exec("ALTER TABLE book_loans DISABLE TRIGGER book_loans_circulation_stats")) {
+        LOG_ERROR("generate").sql(query.lastError()).message("ошибка отключения триггера");
+        db_.rollback();
+        return false;
+    }
+
+    TRACE_SPAN("copy");
+    CopyStream copy(conn);
+    qint64 rows = 0;
+    bool ok = copy.begin("categories (category_id, name)");
+    for (int id = 1; ok && id <= categories; ++id) {
+        ok = copy.field(id).field(kCategories[id - 1]).end_row();
+    }
+    ok = ok && copy.finish();
+    rows += copy.rows();
+
+    QByteArray firstName;
+    QByteArray lastName;
+    // Различные сочетания выбираются частичной перестановкой Фишера — Йетса
+    std::vector<int> names(std::size_t(kAuthorNames));
+    for (int i = 0; i < kAuthorNames; ++i) {
+        names[std::size_t(i)] = i;
+    }
+    ok = ok && copy.begin("authors (author_id, first_name, last_name)");
+    for (int id = 1; ok && id <= authors; ++id) {
+        const int i = id - 1;
+        std::swap(names[std::size_t(i)], names[std::size_t(i + random.below(kAuthorNames - i))]);
+        author_name(names[std::size_t(i)], &firstName, &lastName);
+        ok = copy.field(id).field(firstName).field(lastName).end_row();
+    }
+    ok = ok && copy.finish();
+    rows += copy.rows();
+
+    QByteArray title;
+    const int titleVariants = int(std::size(kTitleHeads) * std::size(kTitleTails));
+    ok = ok && copy.begin("books (book_id, title, author_id, category_id, availability_count, total_copies)");
+    for (int id = 1; ok && id <= config_.books; ++id) {
+        // Сочетания повторяются у разных авторов; номер части различает книги одного автора
+        const int variant = random.below(titleVariants);
+        title = kTitleHeads[variant / int(std::size(kTitleTails))];
+        title += ' ';
+        title += kTitleTails[variant % int(std::size(kTitleTails))];
+        if (random.below(4) == 0) {
+            title += ". Часть ";
+            title += QByteArray::number(2 + random.below(5));
+        }
+        const std::size_t book = std::size_t(id);
+        ok = copy.field(id).field(title).field(authorOutput.sample(random))
+                 .field(categoryShare.sample(random)).field(copies[book] - onLoan[book])
+                 .field(copies[book]).end_row();
+    }
+    ok = ok && copy.finish();
+    rows += copy.rows();
+
+    ok = ok && copy.begin("users (user_id, first_name, last_name, library_card_number)");
+    for (int id = 1; ok && id <= config_.users; ++id) {
+        person(random, &firstName, &lastName);
+        ok = copy.field(id).field(firstName).field(lastName).field(QByteArray::number(10000000 + id)).end_row();
+    }
+    ok = ok && copy.finish();
+    rows += copy.rows();
+
+    ok = ok && copy.begin("book_loans (loan_id, book_id, user_id, loan_date, return_date)");
+    for (std::size_t i = 0; ok && i < loans.size(); ++i) {
+        const Loan &loan = loans[i];
+        copy.field(int(i) + 1).field(loan.book_id).field(loan.user_id)
+            .field(dates[std::size_t(loan.loan_day - firstDay)]);
+        if (loan.return_day < 0) {
+            copy.null();
+        } else {
+            copy.field(dates[std::size_t(loan.return_day - firstDay)]);
+        }
+        ok = copy.end_row();
+    }
+    ok = ok && copy.finish();
+    rows += copy.rows();
+
+    if (!ok) {
+        LOG_ERROR("generate").sql(copy_error(conn)).message("ошибка загрузки COPY");
+        copy.abort();
+        db_.rollback();
+        return false;
+    }
+
+    // Ключи заданы явно, поэтому последовательности переводятся за максимальный ключ
+    const char *const keys[][2] = {
+        {"categories", "category_id"}, {"authors", "author_id"}, {"books", "book_id"},
+        {"users", "user_id"}, {"book_loans", "loan_id"},
+    };
+    for (const auto &key : keys) {
+        const QString sql = QString("SELECT setval(pg_get_serial_sequence('%1', '%2'), MAX(%2)) FROM %1")
+                                .arg(QLatin1String(key[0]), QLatin1String(key[1]));
+        if (!query.exec(sql)) {
+            LOG_ERROR("generate").sql(query.lastError()).message("ошибка обновления последовательности");
+            db_.rollback();
+            return false;
+        }
+    }
+
+    if (!query.exec("ALTER TABLE book_loans ENABLE TRIGGER book_loans_circulation_stats")) {
+        LOG_ERROR("generate").sql(query.lastError()).message("ошибка включения триггера");
+        db_.rollback();
+        return false;
+    }
+    if (!db_.commit()) {
+        LOG_ERROR("generate").sql(db_.lastError()).message("ошибка фиксации транзакции");
+        return false;
+    }
+
+    // Таблицы статистики пусты, поэтому миграция заполняет их по загруженной истории
+    if (!Schema::migrate(db_) || !query.exec("ANALYZE")) {
+        LOG_ERROR("generate").sql(query.lastError()).message("ошибка заполнения статистики");
+        return false;
+    }
+
+    LOG_INFO("generate").latency(timer);
+    if (stats) {
+        stats->rows = rows;
+        stats->elapsed_ms = timer.elapsed();
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include <QDate>
+#include <QSqlDatabase>
+#include <QtGlobal>
+
+/**
+ * @brief Генератор синтетического набора данных для нагрузочных замеров
+ *
+ * Заполняет пустые таблицы authors, categories, books, users и book_loans
+ * детерминированными данными: при одинаковых зерне, размерах и дате
+ * отсчета (Config::today) строки совпадают побайтно, кроме служебных
+ * колонок updated_at. Имена и названия русские; популярность книг и
+ * активность читателей распределены по закону Ципфа, поэтому, как и в
+ * жизни, небольшая доля книг дает основную часть выдач.
+ *
+ * Данные загружаются через COPY ... FROM STDIN (libpq) в одной транзакции.
+ * Триггер статистики на время загрузки отключается, а таблицы статистики
+ * затем заполняются одним проходом миграции (Schema::migrate).
+ */
+class DatasetGenerator {
+public:
+    /**
+     * @brief Размер и параметры набора
+     */
+    struct Config {
+        quint64 seed = 1;           ///< Зерно генератора случайных чисел
+        int authors = 20000;        ///< Количество авторов (не больше числа различных полных имен, 131 544)
+        int books = 200000;         ///< Количество книг
+        int users = 50000;          ///< Количество читателей
+        int loans = 2000000;        ///< Количество выдач
+        int years = 3;              ///< Глубина истории выдач (лет до today)
+        double zipf = 1.0;          ///< Показатель распределения Ципфа для популярности книг
+        QDate today;                ///< Последний день истории выдач (недействительная — текущая дата)
+
+        /**
+         * @brief Размеры по умолчанию, умноженные на scale
+         * @param scale Множитель (например, 0.01 для быстрого прогона)
+         */
+        static Config scaled(double scale);
+    };
+
+    /**
+     * @brief Итоги загрузки
+     */
+    struct Stats {
+        qint64 rows = 0;        ///< Загружено строк во всех таблицах
+        qint64 elapsed_ms = 0;  ///< Длительность генерации и загрузки
+    };
+
+    /**
+     * @brief Конструктор
+     * @param db Подключение к базе данных (драйвер QPSQL)
+     * @param config Размер и параметры набора
+     */
+    DatasetGenerator(const QSqlDatabase& db, const Config& config);
+
+    /**
+     * @brief Генерирует и загружает набор данных
+     * @param stats Итоги загрузки (может быть nullptr)
+     * @return true если данные зафиксированы; false если таблицы не пусты
+     *         или загрузка не удалась (транзакция откатывается)
+     */
+    bool run(Stats* stats = nullptr);
+
+private:
+    QSqlDatabase db_;  ///< Подключение к базе данных
+    Config config_;    ///< Размер и параметры набора
+};
+
+#endif // DATAGEN_H
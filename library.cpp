@@ -1,16 +1,35 @@
 #include "library.h"
+#include "connector.h"
 #include "book.h"
 #include "user.h"
+#include "statements.h"
 #include "ui_mainwindow.h"
+#include "logger.h"
+#include "tracer.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
-#include <QDebug>
+#include <QElapsedTimer>
 
 /**
  * @brief Конструктор по умолчанию класса Library
  */
-Library::Library() {}
+Library::Library()
+{
+    QObject::connect(&probe_timer_, &QTimer::timeout, &probe_timer_, [this]() { probe_replica(); });
+}
+
+/**
+ * @brief Деструктор класса Library
+ * @note Освобождает подготовленные операторы до закрытия подключения
+ */
+Library::~Library()
+{
+    sql::default_cache().clear();
+    if (replica_.isValid()) {
+        sql::cache_for(replica_).clear();
+    }
+}
 
 /**
  * @brief Подключается к базе данных PostgreSQL
@@ -24,19 +43,175 @@ Library::Library() {}
 bool Library::connect_to_database(const QString &host, const QString &db_name,
                                   const QString &user, const QString &password)
 {
+    // Операторы, подготовленные на прежнем подключении, становятся недействительными
+    sql::default_cache().clear();
     db_ = QSqlDatabase::addDatabase("QPSQL");
     db_.setHostName(host);
     db_.setDatabaseName(db_name);
     db_.setUserName(user);
     db_.setPassword(password);
+    // Подключение открывается в главном потоке; ожидание сервера ограничено
+    db_.setConnectOptions("connect_timeout=5");
 
     if (!db_.open()) {
-        qWarning() << "Ошибка подключения к базе данных: " << db_.lastError().text();
+        LOG_ERROR("connect").sql(db_.lastError()).message("ошибка подключения к базе данных");
         return false;
     }
     return true;
 }
 
+/**
+ * @brief Подключает реплику только для чтения
+ * @param host Хост реплики
+ * @param db_name Имя базы данных
+ * @param user Имя пользователя БД
+ * @param password Пароль пользователя БД
+ * @param max_staleness_ms Допустимое отставание реплики, мс
+ * @note Пока реплика недоступна, отчеты читаются с основной БД; подключение
+ * открывается из цикла событий после ответа сервера (open_replica)
+ */
+void Library::connect_to_replica(const QString &host, const QString &db_name,
+                                 const QString &user, const QString &password,
+                                 int max_staleness_ms)
+{
+    replica_connector_.reset();
+    probe_timer_.stop();
+    if (replica_.isValid()) {
+        sql::cache_for(replica_).clear();
+    }
+    replica_ = QSqlDatabase::addDatabase("QPSQL", "replica");
+    replica_.setHostName(host);
+    replica_.setDatabaseName(db_name);
+    replica_.setUserName(user);
+    replica_.setPassword(password);
+    // Сервер уже ответил на проверку, но окно не должно ждать его дольше этого
+    replica_.setConnectOptions("connect_timeout=2");
+    max_staleness_ms_ = max_staleness_ms;
+
+    replica_connector_ = std::make_unique<DatabaseConnector>(host, db_name, user, password);
+    QObject::connect(replica_connector_.get(), &DatabaseConnector::reachable,
+                     replica_connector_.get(), [this]() { open_replica(); });
+    replica_connector_->start();
+}
+
+/**
+ * @brief Открывает реплику после ответа сервера на проверку
+ * @note Первое измерение отставания выполняется сразу, следующие — по таймеру
+ */
+void Library::open_replica()
+{
+    replica_lag_ms_.reset();
+    wal_samples_.clear();
+    replica_clock_.start();
+    if (!replica_.open()) {
+        replica_failed(replica_.lastError());
+        return;
+    }
+    if (probe_replica()) {
+        probe_timer_.start(kReplicaProbeMs);
+    }
+}
+
+/**
+ * @brief Отмечает запись на основной БД
+ */
+void Library::note_write()
+{
+    write_timer_.start();
+}
+
+/**
+ * @brief Можно ли сейчас читать с реплики
+ * @return true если реплика открыта, достаточно свежа и уже содержит
+ *         последнюю запись этого рабочего места
+ */
+bool Library::use_replica() const
+{
+    if (!replica_.isValid() || !replica_.isOpen()) {
+        return false;
+    }
+
+    // Неизвестное отставание (реплика не принимает WAL) — читаем с основной БД
+    if (!replica_lag_ms_ || *replica_lag_ms_ > max_staleness_ms_) {
+        return false;
+    }
+    // Отставание измерено до kReplicaProbeMs назад, поэтому запас берется на период измерения
+    return !write_timer_.isValid()
+        || write_timer_.hasExpired(*replica_lag_ms_ + kReplicaProbeMs);
+}
+
+/**
+ * @brief Оценивает отставание реплики по позициям WAL основной БД
+ * @return false при ошибке на реплике; если недоступна основная БД, новая позиция
+ *         не запоминается и оценка отставания только растет
+ */
+bool Library::probe_replica()
+{
+    const qint64 now = replica_clock_.elapsed();
+    // Основная БД может быть еще не подключена, если реплика ответила первой
+    if (db_.isOpen()) {
+        auto primary = sql::cache_for(db_).exec<stmt::WalPosition>();
+        if (primary.next()) {
+            wal_samples_.emplace_back(now, primary.row().lsn);
+        }
+    }
+
+    auto replay = sql::cache_for(replica_).exec<stmt::ReplayPosition>();
+    if (!replay.next()) {
+        replica_failed(replay.error());
+        return false;
+    }
+    const auto row = replay.row();
+    if (!row.in_recovery) {
+        // Реплика повышена до основной БД: WAL не применяется, данные актуальны
+        replica_lag_ms_ = 0;
+        wal_samples_.clear();
+        return true;
+    }
+
+    // Позиции старше допустимого отставания уже ничего не решают
+    while (!wal_samples_.empty()
+           && now - wal_samples_.front().first > max_staleness_ms_ + kReplicaProbeMs) {
+        wal_samples_.pop_front();
+    }
+    replica_lag_ms_.reset();
+    if (!row.replayed_lsn) {
+        return true;
+    }
+    // Впереди остается самая поздняя позиция, которую реплика уже применила
+    while (wal_samples_.size() > 1 && wal_samples_[1].second <= *row.replayed_lsn) {
+        wal_samples_.pop_front();
+    }
+    if (!wal_samples_.empty() && wal_samples_.front().second <= *row.replayed_lsn) {
+        replica_lag_ms_ = now - wal_samples_.front().first;
+    }
+    return true;
+}
+
+/**
+ * @brief Исключает реплику из маршрутизации до следующей проверки подключения
+ * @param error Ошибка, полученная на реплике
+ * @note Повторное подключение идет через DatabaseConnector и не блокирует окно
+ */
+void Library::replica_failed(const QSqlError &error)
+{
+    LOG_WARNING("replica").sql(error).message("реплика недоступна, чтение с основной БД");
+    probe_timer_.stop();
+    sql::cache_for(replica_).clear();
+    replica_.close();
+    replica_lag_ms_.reset();
+    replica_connector_->retry_later();
+}
+
+/**
+ * @brief Возвращает подключение к базе данных
+ * @return Подключение к базе данных
+ */
+QSqlDatabase Library::database() const
+{
+    return db_;
+}
+
 /**
  * @brief Выдает книгу пользователю
  * @param book Книга для выдачи (объект класса Book)
@@ -47,49 +222,68 @@ bool Library::connect_to_database(const QString &host, const QString &db_name,
  * 2. Находит ID пользователя
  * 3. Создает запись о выдаче
  * 4. Уменьшает счетчик доступных книг
+ *
+ * Все шаги выполняются в одной транзакции; статистика выдач
+ * обновляется триггером в этой же транзакции.
  */
 bool Library::issue_book(const Book &book, const QString &card_number) {
-    // Проверка доступности книги
-    QSqlQuery checkQuery;
-    checkQuery.prepare("SELECT book_id, availability_count FROM books WHERE title = :title AND author_id = "
-                       "(SELECT author_id FROM authors WHERE first_name || ' ' || last_name = :author)");
-    checkQuery.bindValue(":title", book.title());
-    checkQuery.bindValue(":author", book.author());
+    TRACE_SPAN("Library::issue_book");
+    QElapsedTimer timer;
+    timer.start();
 
-    if (!checkQuery.exec() || !checkQuery.next() || checkQuery.value("availability_count").toInt() <= 0) {
-        qWarning() << "Ошибка выдачи книги: книга недоступна или не найдена.";
+    if (!db_.transaction()) {
+        LOG_ERROR("issue_book").card(card_number).sql(db_.lastError()).message("ошибка начала транзакции");
+        return false;
+    }
+    sql::StatementCache &statements = sql::cache_for(db_);
+
+    // Проверка доступности книги
+    tracing::Span resolveSpan("resolve_ids");
+    auto checkQuery = statements.exec<stmt::FindBook>(book.title(), book.author());
+    if (!checkQuery.next() || checkQuery.row().availability_count <= 0) {
+        LOG_WARNING("issue_book").card(card_number).sql(checkQuery.error()).message("книга недоступна или не найдена");
+        db_.rollback();
         return false;
     }
-    int bookId = checkQuery.value("book_id").toInt();
+    int bookId = checkQuery.row().book_id;
 
     // Поиск пользователя
-    QSqlQuery userQuery;
-    userQuery.prepare("SELECT user_id FROM users WHERE library_card_number = :libraryCardNumber");
-    userQuery.bindValue(":libraryCardNumber", card_number);
-    if (!userQuery.exec() || !userQuery.next()) {
-        qWarning() << "Ошибка получения пользователя: пользователь не найден.";
+    auto userQuery = statements.exec<stmt::FindUser>(card_number);
+    if (!userQuery.next()) {
+        LOG_WARNING("issue_book").card(card_number).book(bookId).sql(userQuery.error()).message("пользователь не найден");
+        db_.rollback();
         return false;
     }
-    int userId = userQuery.value("user_id").toInt();
+    int userId = userQuery.row().user_id;
+    resolveSpan.end();
 
     // Создание записи о выдаче
-    QSqlQuery issueQuery;
-    issueQuery.prepare("INSERT INTO book_loans (book_id, user_id, loan_date) VALUES (:bookId, :userId, CURRENT_DATE)");
-    issueQuery.bindValue(":bookId", bookId);
-    issueQuery.bindValue(":userId", userId);
-    if (!issueQuery.exec()) {
-        qWarning() << "Ошибка выдачи книги:" << issueQuery.lastError().text();
+    auto issueQuery = statements.exec<stmt::InsertLoan>(bookId, userId);
+    if (!issueQuery.ok()) {
+        LOG_ERROR("issue_book").card(card_number).book(bookId).sql(issueQuery.error()).message("ошибка записи выдачи");
+        db_.rollback();
         return false;
     }
 
     // Обновление счетчика книг
-    QSqlQuery updateQuery;
-    updateQuery.prepare("UPDATE books SET availability_count = availability_count - 1 WHERE book_id = :bookId");
-    updateQuery.bindValue(":bookId", bookId);
-    if (!updateQuery.exec()) {
-        qWarning() << "Ошибка обновления количества книг:" << updateQuery.lastError().text();
+    auto updateQuery = statements.exec<stmt::AdjustAvailability>(-1, bookId);
+    if (!updateQuery.ok()) {
+        LOG_ERROR("issue_book").card(card_number).book(bookId).sql(updateQuery.error()).message("ошибка обновления количества книг");
+        db_.rollback();
         return false;
     }
+
+    // Фиксация транзакции
+    tracing::Span commitSpan("commit");
+    const bool committed = db_.commit();
+    commitSpan.end();
+    if (!committed) {
+        LOG_ERROR("issue_book").card(card_number).book(bookId).sql(db_.lastError()).message("ошибка фиксации транзакции");
+        db_.rollback();
+        return false;
+    }
+    note_write();
+    LOG_INFO("issue_book").card(card_number).book(bookId).latency(timer);
     return true;
 }
 
@@ -104,57 +298,75 @@ bool Library::issue_book(const Book &book, const QString &card_number) {
  * 3. Проверяет, что книга была выдана
  * 4. Отмечает возврат в БД
  * 5. Увеличивает счетчик доступных книг
+ *
+ * Все шаги выполняются в одной транзакции.
  */
 bool Library::return_book(const QString &card_number, const Book &book) {
+    TRACE_SPAN("Library::return_book");
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!db_.transaction()) {
+        LOG_ERROR("return_book").card(card_number).sql(db_.lastError()).message("ошибка начала транзакции");
+        return false;
+    }
+    sql::StatementCache &statements = sql::cache_for(db_);
+
     // Поиск пользователя
-    QSqlQuery userQuery;
-    userQuery.prepare("SELECT user_id FROM users WHERE library_card_number = :libraryCardNumber");
-    userQuery.bindValue(":libraryCardNumber", card_number);
-    if (!userQuery.exec() || !userQuery.next()) {
-        qWarning() << "Ошибка: пользователь не найден по номеру библиотечного билета.";
+    tracing::Span resolveSpan("resolve_ids");
+    auto userQuery = statements.exec<stmt::FindUser>(card_number);
+    if (!userQuery.next()) {
+        LOG_WARNING("return_book").card(card_number).sql(userQuery.error()).message("пользователь не найден");
+        db_.rollback();
         return false;
     }
-    int userId = userQuery.value("user_id").toInt();
+    int userId = userQuery.row().user_id;
 
     // Поиск книги
-    QSqlQuery bookQuery;
-    bookQuery.prepare("SELECT book_id FROM books WHERE title = :title AND author_id = "
-                      "(SELECT author_id FROM authors WHERE first_name || ' ' || last_name = :author)");
-    bookQuery.bindValue(":title", book.title());
-    bookQuery.bindValue(":author", book.author());
-    if (!bookQuery.exec() || !bookQuery.next()) {
-        qWarning() << "Ошибка возврата книги: книга не найдена.";
+    auto bookQuery = statements.exec<stmt::FindBook>(book.title(), book.author());
+    if (!bookQuery.next()) {
+        LOG_WARNING("return_book").card(card_number).sql(bookQuery.error()).message("книга не найдена");
+        db_.rollback();
         return false;
     }
-    int bookId = bookQuery.value("book_id").toInt();
+    int bookId = bookQuery.row().book_id;
 
     // Проверка выдачи книги
-    QSqlQuery loanQuery;
-    loanQuery.prepare("SELECT loan_id FROM book_loans WHERE book_id = :bookId AND user_id = :userId AND return_date IS NULL");
-    loanQuery.bindValue(":bookId", bookId);
-    loanQuery.bindValue(":userId", userId);
-    if (!loanQuery.exec() || !loanQuery.next()) {
-        qWarning() << "Ошибка: книга не была выдана этому пользователю или уже возвращена.";
+    auto loanQuery = statements.exec<stmt::FindOpenLoan>(bookId, userId);
+    if (!loanQuery.next()) {
+        LOG_WARNING("return_book").card(card_number).book(bookId).sql(loanQuery.error()).message("книга не выдана этому пользователю или уже возвращена");
+        db_.rollback();
         return false;
     }
-    int loanId = loanQuery.value("loan_id").toInt();
+    int loanId = loanQuery.row().loan_id;
+    resolveSpan.end();
 
     // Отметка о возврате
-    QSqlQuery returnQuery;
-    returnQuery.prepare("UPDATE book_loans SET return_date = CURRENT_DATE WHERE loan_id = :loanId");
-    returnQuery.bindValue(":loanId", loanId);
-    if (!returnQuery.exec()) {
-        qWarning() << "Ошибка возврата книги:" << returnQuery.lastError().text();
+    auto returnQuery = statements.exec<stmt::CloseLoan>(loanId);
+    if (!returnQuery.ok()) {
+        LOG_ERROR("return_book").card(card_number).book(bookId).sql(returnQuery.error()).message("ошибка отметки о возврате");
+        db_.rollback();
         return false;
     }
 
     // Обновление счетчика книг
-    QSqlQuery updateQuery;
-    updateQuery.prepare("UPDATE books SET availability_count = availability_count + 1 WHERE book_id = :bookId");
-    updateQuery.bindValue(":bookId", bookId);
-    if (!updateQuery.exec()) {
-        qWarning() << "Ошибка обновления количества книг:" << updateQuery.lastError().text();
+    auto updateQuery = statements.exec<stmt::AdjustAvailability>(1, bookId);
+    if (!updateQuery.ok()) {
+        LOG_ERROR("return_book").card(card_number).book(bookId).sql(updateQuery.error()).message("ошибка обновления количества книг");
+        db_.rollback();
+        return false;
+    }
+
+    // Фиксация транзакции
+    tracing::Span commitSpan("commit");
+    const bool committed = db_.commit();
+    commitSpan.end();
+    if (!committed) {
+        LOG_ERROR("return_book").card(card_number).book(bookId).sql(db_.lastError()).message("ошибка фиксации транзакции");
+        db_.rollback();
         return false;
     }
+    note_write();
+    LOG_INFO("return_book").card(card_number).book(bookId).latency(timer);
     return true;
 }
@@ -3,8 +3,18 @@
 
 #include <QString>
 #include <QSqlDatabase>
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <utility>
 #include "book.h"
 #include "user.h"
+#include "statements.h"
+
+class DatabaseConnector;
 
 /**
  * @brief Класс для работы с библиотечной базой данных
@@ -13,6 +23,7 @@
  * - Подключение к PostgreSQL
  * - Выдача книг читателям
  * - Прием возвращенных книг
+ * - Маршрутизация отчетных запросов на реплику только для чтения
  */
 class Library {
 public:
@@ -21,6 +32,11 @@ public:
      */
     Library();
 
+    /**
+     * @brief Деструктор
+     */
+    ~Library();
+
     /**
      * @brief Подключается к PostgreSQL базе данных
      * @param host Адрес сервера БД
@@ -32,6 +48,64 @@ public:
     bool connect_to_database(const QString& host, const QString& db_name,
                              const QString& user, const QString& password);
 
+    /**
+     * @brief Подключает реплику только для чтения (потоковая репликация PostgreSQL)
+     *
+     * Не блокирует: реплика проверяется DatabaseConnector и открывается,
+     * когда сервер ответил; при отказе проверка повторяется им же. Пока
+     * реплика не открыта, чтение идет с основной БД. Требует цикла событий.
+     * @param host Адрес сервера реплики
+     * @param db_name Имя базы данных
+     * @param user Имя пользователя БД
+     * @param password Пароль пользователя
+     * @param max_staleness_ms Допустимое отставание реплики, мс
+     */
+    void connect_to_replica(const QString& host, const QString& db_name,
+                            const QString& user, const QString& password,
+                            int max_staleness_ms);
+
+    /**
+     * @brief Выполняет отчетный запрос на реплике или на основной БД
+     *
+     * Реплика используется, если она доступна, ее отставание известно и не
+     * больше допустимого и с момента последней записи этого рабочего места
+     * прошло больше времени, чем отставание (чтение своих записей). При ошибке на
+     * реплике запрос повторяется на основной БД, а реплика временно
+     * исключается из маршрутизации.
+     * @param args Параметры оператора S
+     * @return Результат выполнения
+     */
+    template <typename S, typename... Args>
+    sql::Result<S> read(Args&&... args)
+    {
+        if (use_replica()) {
+            auto result = sql::cache_for(replica_).exec<S>(args...);
+            if (result.ok()) {
+                return result;
+            }
+            replica_failed(result.error());
+        }
+        return sql::cache_for(db_).exec<S>(std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Отмечает запись на основной БД, сделанную в обход Library
+     * @note Следующие чтения идут с основной БД, пока реплика не догонит запись
+     */
+    void note_write();
+
+    /**
+     * @brief Допустимое отставание реплики
+     * @return мс; 0, если реплика не подключалась (все чтения с основной БД)
+     */
+    int max_staleness_ms() const { return max_staleness_ms_; }
+
+    /**
+     * @brief Возвращает подключение к базе данных
+     * @return Подключение (открытое после успешного connect_to_database)
+     */
+    QSqlDatabase database() const;
+
     /**
      * @brief Выдает книгу читателю
      * @param book Книга для выдачи
@@ -49,7 +123,47 @@ public:
     bool return_book(const QString& card_number, const Book& book);
 
 private:
-    QSqlDatabase db_; ///< Подключение к базе данных
+    /**
+     * @brief Можно ли сейчас читать с реплики
+     * @note Отставание обновляется таймером раз в kReplicaProbeMs (probe_replica)
+     */
+    bool use_replica() const;
+
+    /**
+     * @brief Открывает реплику, ответившую на проверку, и запускает измерение отставания
+     */
+    void open_replica();
+
+    /**
+     * @brief Оценивает отставание реплики по позициям WAL
+     *
+     * Запоминает позицию WAL основной БД и время ее чтения; реплика,
+     * применившая позицию, прочитанную в момент T, отстает не больше чем
+     * на (сейчас - T). Если реплика не применила ни одну из запомненных
+     * позиций за последние max_staleness_ms_ (например, отключен прием
+     * WAL), отставание неизвестно. Вызывается по таймеру, а не при чтении,
+     * чтобы к моменту редкого отчетного запроса уже была история позиций.
+     * @return false при ошибке на реплике
+     */
+    bool probe_replica();
+
+    /**
+     * @brief Исключает реплику из маршрутизации до повторной проверки подключения
+     * @param error Ошибка, полученная на реплике
+     */
+    void replica_failed(const QSqlError& error);
+
+    static constexpr int kReplicaProbeMs = 1000;   ///< Период измерения отставания реплики
+
+    QSqlDatabase db_;               ///< Подключение к базе данных
+    QSqlDatabase replica_;          ///< Подключение к реплике (может быть не задано)
+    int max_staleness_ms_ = 0;      ///< Допустимое отставание реплики
+    std::optional<qint64> replica_lag_ms_;  ///< Оценка отставания реплики (нет — неизвестно)
+    std::deque<std::pair<qint64, qint64>> wal_samples_;  ///< Позиции WAL основной БД: (время по replica_clock_, LSN)
+    QElapsedTimer replica_clock_;   ///< Часы для wal_samples_
+    QTimer probe_timer_;            ///< Период измерения отставания (работает, пока реплика открыта)
+    QElapsedTimer write_timer_;     ///< Время с последней записи на основную БД
+    std::unique_ptr<DatabaseConnector> replica_connector_;  ///< Неблокирующая проверка реплики
 };
 
 #endif // LIBRARY_H
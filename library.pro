@@ -6,18 +6,58 @@ CONFIG += c++17
 CONFIG -= app_bundle
 CONFIG += console
 
+# libpq: загрузка синтетических данных через COPY (datagen.cpp) и
+# неблокирующая проверка подключения (connector.cpp)
+win32 {
+    # Каталог установки PostgreSQL: qmake PG_DIR="C:/Program Files/PostgreSQL/16"
+    # или переменная окружения PG_DIR; при запуске libpq.dll должна быть в PATH
+    isEmpty(PG_DIR): PG_DIR = $$(PG_DIR)
+    isEmpty(PG_DIR): error("Не задан PG_DIR — каталог установки PostgreSQL с include и lib")
+    INCLUDEPATH += $$quote($$PG_DIR/include)
+    LIBS += -L$$quote($$PG_DIR/lib) -llibpq
+} else {
+    unix: INCLUDEPATH += /usr/include/postgresql
+    LIBS += -lpq
+}
+
 # Путь к исходным файлам проекта
 SOURCES += \
     book.cpp \
+    catalogcache.cpp \
+    catalogmodel.cpp \
+    connector.cpp \
+    console.cpp \
+    datagen.cpp \
     library.cpp \
+    logger.cpp \
     main.cpp \
     mainwindow.cpp \
+    overdue.cpp \
+    plancheck.cpp \
+    reconcile.cpp \
+    schema.cpp \
+    statistics.cpp \
+    tracer.cpp \
     user.cpp
 
 HEADERS += \
     book.h \
+    catalogcache.h \
+    catalogmodel.h \
+    connector.h \
+    console.h \
+    datagen.h \
     library.h \
+    logger.h \
     mainwindow.h \
+    overdue.h \
+    plancheck.h \
+    reconcile.h \
+    schema.h \
+    sqlregistry.h \
+    statements.h \
+    statistics.h \
+    tracer.h \
     user.h
 
 FORMS += \
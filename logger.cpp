@@ -0,0 +1,486 @@
+#include "logger.h"
+#include <QFile>
+#include <QByteArray>
+#include <QtGlobal>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace logging {
+namespace {
+
+/**
+ * @brief Ограниченная очередь без блокировок (много писателей, один читатель)
+ *
+ * Каждая ячейка хранит номер последовательности: писатель занимает
+ * позицию атомарным CAS и публикует запись, увеличивая номер ячейки;
+ * читатель забирает запись и освобождает ячейку для следующего круга.
+ */
+class Ring {
+public:
+    static constexpr std::size_t kCapacity = 4096; ///< Емкость (степень двойки)
+
+    Ring()
+    {
+        for (std::size_t i = 0; i < kCapacity; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Помещает запись в очередь
+     * @return false если очередь заполнена
+     */
+    bool push(const Record &record)
+    {
+        std::size_t pos = enqueue_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells_[pos & (kCapacity - 1)];
+            const std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+            const std::intptr_t diff = std::intptr_t(seq) - std::intptr_t(pos);
+            if (diff == 0) {
+                if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.record = record;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Проверяет, есть ли в очереди опубликованная запись (только из потока записи)
+     */
+    bool empty() const
+    {
+        const Cell &cell = cells_[dequeue_ & (kCapacity - 1)];
+        return std::intptr_t(cell.sequence.load(std::memory_order_acquire)) - std::intptr_t(dequeue_ + 1) < 0;
+    }
+
+    /**
+     * @brief Забирает запись из очереди (только из потока записи)
+     * @return false если очередь пуста
+     */
+    bool pop(Record &record)
+    {
+        Cell &cell = cells_[dequeue_ & (kCapacity - 1)];
+        const std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (std::intptr_t(seq) - std::intptr_t(dequeue_ + 1) < 0) {
+            return false;
+        }
+        record = cell.record;
+        cell.sequence.store(dequeue_ + kCapacity, std::memory_order_release);
+        ++dequeue_;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        Record record;
+    };
+
+    Cell cells_[kCapacity];
+    alignas(64) std::atomic<std::size_t> enqueue_{0};
+    alignas(64) std::size_t dequeue_ = 0;
+};
+
+Ring g_ring;
+std::atomic<int> g_level{int(Level::Info)};
+std::atomic<bool> g_running{false};
+std::atomic<quint64> g_dropped{0};
+std::thread g_writer;
+Config g_config;
+std::FILE *g_file = nullptr;
+qint64 g_size = 0;
+
+/// @name Пробуждение потока записи
+/// Поток записи засыпает, только выставив g_sleeping, а писатель будит его,
+/// если после помещения записи застал флаг выставленным, то есть только
+/// при переходе буфера из пустого состояния в непустое
+/// @{
+std::mutex g_wake_mutex;
+std::condition_variable g_wake;
+std::atomic<bool> g_sleeping{false};
+constexpr auto kIdleWait = std::chrono::seconds(1);  ///< Страховочный период проверки буфера
+/// @}
+
+/**
+ * @brief Будит поток записи, если он ждет
+ */
+void wake_writer()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (g_sleeping.load(std::memory_order_relaxed) && g_sleeping.exchange(false)) {
+        std::lock_guard<std::mutex> lock(g_wake_mutex);
+        g_wake.notify_one();
+    }
+}
+
+/**
+ * @brief Ждет новых записей или остановки (не дольше kIdleWait)
+ */
+void wait_for_records()
+{
+    std::unique_lock<std::mutex> lock(g_wake_mutex);
+    g_sleeping.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!g_ring.empty() || !g_running.load(std::memory_order_acquire)) {
+        g_sleeping.store(false);
+        return;
+    }
+    g_wake.wait_for(lock, kIdleWait, [] { return !g_sleeping.load(); });
+    g_sleeping.store(false);
+}
+
+const char *level_name(Level level)
+{
+    switch (level) {
+    case Level::Debug: return "DEBUG";
+    case Level::Info: return "INFO";
+    case Level::Warning: return "WARN";
+    case Level::Error: return "ERROR";
+    case Level::Off: break;
+    }
+    return "OFF";
+}
+
+/**
+ * @brief Дописывает строку в кавычках, экранируя кавычки и переводы строк
+ */
+void append_quoted(std::string &line, const QByteArray &text)
+{
+    line += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            line += '\\';
+            line += c;
+        } else if (c == '\n' || c == '\r') {
+            line += ' ';
+        } else {
+            line += c;
+        }
+    }
+    line += '"';
+}
+
+/**
+ * @brief Форматирует запись в строку вида key=value
+ */
+void format(const Record &record, std::string &line)
+{
+    const std::time_t seconds = std::time_t(record.timestamp_us / 1000000);
+    std::tm local{};
+#ifdef Q_OS_WIN
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    char stamp[48];
+    const std::size_t stampSize = std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &local);
+    std::snprintf(stamp + stampSize, sizeof(stamp) - stampSize, ".%06lld",
+                  static_cast<long long>(record.timestamp_us % 1000000));
+
+    line.clear();
+    line += stamp;
+    line += ' ';
+    line += level_name(record.level);
+    line += " op=";
+    line += record.operation;
+    if (record.card_size > 0) {
+        line += " card=";
+        append_quoted(line, QString::fromUtf16(record.card, record.card_size).toUtf8());
+    }
+    if (record.book_id >= 0) {
+        line += " book_id=";
+        line += std::to_string(record.book_id);
+    }
+    if (record.latency_us >= 0) {
+        line += " latency_us=";
+        line += std::to_string(record.latency_us);
+    }
+    if (record.code_size > 0) {
+        line += " sql_code=";
+        line.append(record.code, record.code_size);
+    }
+    if (record.error_size > 0) {
+        line += " sql_error=";
+        append_quoted(line, QString::fromUtf16(record.error, record.error_size).toUtf8());
+    }
+    if (record.message) {
+        line += " msg=";
+        append_quoted(line, QByteArray(record.message));
+    }
+    line += '\n';
+}
+
+/**
+ * @brief Открывает файл журнала; если это не удалось, записи идут в stderr
+ */
+std::FILE *open_file()
+{
+    std::FILE *file = std::fopen(QFile::encodeName(g_config.path).constData(), "ab");
+    if (!file) {
+        std::fprintf(stderr, "Не удалось открыть журнал %s, записи выводятся в stderr\n",
+                     QFile::encodeName(g_config.path).constData());
+        g_size = 0;
+        return stderr;
+    }
+    std::fseek(file, 0, SEEK_END);
+    g_size = std::ftell(file);
+    return file;
+}
+
+/**
+ * @brief Закрывает файл журнала (stderr не закрывается)
+ */
+void close_file()
+{
+    if (g_file && g_file != stderr) {
+        std::fclose(g_file);
+    }
+    g_file = nullptr;
+}
+
+/**
+ * @brief Ротация: path → path.1 → … → path.N, самый старый файл удаляется;
+ * при max_files = 0 старые записи не хранятся и файл начинается заново
+ */
+void rotate()
+{
+    close_file();
+    for (int i = g_config.max_files; i >= 1; --i) {
+        const QString target = g_config.path + '.' + QString::number(i);
+        const QString source = i == 1 ? g_config.path : g_config.path + '.' + QString::number(i - 1);
+        QFile::remove(target);
+        QFile::rename(source, target);
+    }
+    QFile::remove(g_config.path);
+    g_file = open_file();
+}
+
+void write_loop()
+{
+    Record record;
+    std::string line;
+    line.reserve(512);
+    bool unflushed = false;
+    for (;;) {
+        if (g_ring.pop(record)) {
+            format(record, line);
+            std::fwrite(line.data(), 1, line.size(), g_file);
+            g_size += qint64(line.size());
+            unflushed = true;
+            if (g_file != stderr && g_size >= g_config.max_bytes) {
+                rotate();
+                unflushed = false;
+            }
+            continue;
+        }
+        if (unflushed) {
+            std::fflush(g_file);
+            unflushed = false;
+        }
+        // Остановка проверяется после опустошения буфера, поэтому записи,
+        // помещенные до stop(), дописываются
+        if (!g_running.load(std::memory_order_acquire)) {
+            break;
+        }
+        wait_for_records();
+    }
+    std::fflush(g_file);
+}
+
+} // namespace
+
+/**
+ * @brief Настройки журнала из переменных окружения
+ * @return Настройки
+ */
+Config Config::from_environment()
+{
+    Config config;
+    if (qEnvironmentVariableIsSet("LIBRARY_LOG_FILE")) {
+        config.path = qEnvironmentVariable("LIBRARY_LOG_FILE");
+    }
+    config.level = parse_level(qEnvironmentVariable("LIBRARY_LOG_LEVEL"), config.level);
+    bool ok = false;
+    const qint64 maxBytes = qEnvironmentVariable("LIBRARY_LOG_MAX_BYTES").toLongLong(&ok);
+    if (ok && maxBytes > 0) {
+        config.max_bytes = maxBytes;
+    }
+    const int maxFiles = qEnvironmentVariableIntValue("LIBRARY_LOG_MAX_FILES", &ok);
+    if (ok && maxFiles >= 0) {
+        config.max_files = maxFiles;
+    }
+    return config;
+}
+
+/**
+ * @brief Запускает фоновый поток записи
+ * @param config Настройки журнала
+ * @return true если файл журнала открыт; иначе записи выводятся в stderr
+ */
+bool start(const Config &config)
+{
+    if (g_running.load()) {
+        return true;
+    }
+    g_config = config;
+    set_level(config.level);
+    g_file = open_file();
+    g_running.store(true, std::memory_order_release);
+    g_writer = std::thread(write_loop);
+    return g_file != stderr;
+}
+
+/**
+ * @brief Дописывает накопленные записи и останавливает фоновый поток
+ */
+void stop()
+{
+    if (!g_running.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_wake_mutex);
+        g_sleeping.store(false);
+        g_wake.notify_one();
+    }
+    g_writer.join();
+    close_file();
+}
+
+void set_level(Level level)
+{
+    g_level.store(int(level), std::memory_order_relaxed);
+}
+
+Level level()
+{
+    return Level(g_level.load(std::memory_order_relaxed));
+}
+
+bool enabled(Level level)
+{
+    return int(level) >= g_level.load(std::memory_order_relaxed);
+}
+
+Level parse_level(const QString &name, Level fallback)
+{
+    const QString lower = name.trimmed().toLower();
+    if (lower == "debug") return Level::Debug;
+    if (lower == "info") return Level::Info;
+    if (lower == "warning" || lower == "warn") return Level::Warning;
+    if (lower == "error") return Level::Error;
+    if (lower == "off") return Level::Off;
+    return fallback;
+}
+
+quint64 dropped()
+{
+    return g_dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Начинает запись
+ * @param level Уровень важности
+ * @param operation Название операции (строковый литерал)
+ */
+Event::Event(Level level, const char *operation)
+{
+    using namespace std::chrono;
+    record_.timestamp_us = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+    record_.level = level;
+    record_.operation = operation;
+    record_.message = nullptr;
+    record_.book_id = -1;
+    record_.latency_us = -1;
+    record_.card_size = 0;
+    record_.code_size = 0;
+    record_.error_size = 0;
+}
+
+/**
+ * @brief Отправляет запись в буфер; при переполнении запись отбрасывается
+ */
+Event::~Event()
+{
+    if (!g_ring.push(record_)) {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    wake_writer();
+}
+
+Event &Event::card(const QString &card_number)
+{
+    const int size = qMin(int(card_number.size()), Record::kCardSize);
+    const QChar *data = card_number.constData();
+    for (int i = 0; i < size; ++i) {
+        record_.card[i] = data[i].unicode();
+    }
+    record_.card_size = quint8(size);
+    return *this;
+}
+
+Event &Event::book(int book_id)
+{
+    record_.book_id = book_id;
+    return *this;
+}
+
+Event &Event::latency_us(qint64 latency)
+{
+    record_.latency_us = latency;
+    return *this;
+}
+
+Event &Event::latency(const QElapsedTimer &timer)
+{
+    record_.latency_us = timer.nsecsElapsed() / 1000;
+    return *this;
+}
+
+/**
+ * @brief Добавляет код (SQLSTATE) и текст ошибки SQL; пустая ошибка игнорируется
+ */
+Event &Event::sql(const QSqlError &error)
+{
+    if (error.type() == QSqlError::NoError) {
+        return *this;
+    }
+    const QString code = error.nativeErrorCode();
+    const int codeSize = qMin(int(code.size()), Record::kCodeSize);
+    for (int i = 0; i < codeSize; ++i) {
+        record_.code[i] = char(code[i].toLatin1());
+    }
+    record_.code_size = quint8(codeSize);
+
+    const QString text = error.databaseText().isEmpty() ? error.driverText() : error.databaseText();
+    const int textSize = qMin(int(text.size()), Record::kErrorSize);
+    const QChar *data = text.constData();
+    for (int i = 0; i < textSize; ++i) {
+        record_.error[i] = data[i].unicode();
+    }
+    record_.error_size = quint8(textSize);
+    return *this;
+}
+
+Event &Event::message(const char *text)
+{
+    record_.message = text;
+    return *this;
+}
+
+} // namespace logging
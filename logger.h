@@ -0,0 +1,175 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <QString>
+#include <QSqlError>
+#include <QElapsedTimer>
+
+/**
+ * @brief Асинхронный структурированный журнал
+ *
+ * Вызывающий поток только заполняет запись фиксированного размера и
+ * помещает ее в кольцевой буфер без блокировок; форматирование и запись
+ * в файл выполняет фоновый поток. При переполнении буфера записи
+ * отбрасываются и учитываются счетчиком, вызывающий поток не ждет.
+ * Пока буфер пуст, фоновый поток спит; писатель будит его, только если
+ * застал его спящим, поэтому простаивающее приложение не тратит процессор.
+ *
+ * Каждая запись содержит поля: operation, card, book_id, latency_us,
+ * sql_code, sql_error и короткое сообщение:
+ * @code
+ * LOG_WARNING("issue_book").card(card_number).book(bookId).sql(error).message("книга не найдена");
+ * @endcode
+ * Уровень фильтрации можно менять во время работы (logging::set_level),
+ * отфильтрованные вызовы не вычисляют аргументы.
+ */
+namespace logging {
+
+/**
+ * @brief Уровень важности записи
+ */
+enum class Level : int {
+    Debug = 0,
+    Info = 1,
+    Warning = 2,
+    Error = 3,
+    Off = 4
+};
+
+/**
+ * @brief Настройки журнала
+ */
+struct Config {
+    QString path = "library.log";          ///< Путь к текущему файлу журнала
+    qint64 max_bytes = 10 * 1024 * 1024;   ///< Размер файла, после которого он ротируется
+    int max_files = 5;                     ///< Количество хранимых старых файлов (path.1 … path.N); 0 — не хранить
+    Level level = Level::Info;             ///< Начальный уровень фильтрации
+
+    /**
+     * @brief Настройки из переменных окружения
+     * @return LIBRARY_LOG_FILE, LIBRARY_LOG_LEVEL (debug|info|warning|error|off),
+     *         LIBRARY_LOG_MAX_BYTES, LIBRARY_LOG_MAX_FILES поверх значений по умолчанию
+     */
+    static Config from_environment();
+};
+
+/**
+ * @brief Запускает фоновый поток записи
+ * @param config Настройки журнала
+ * @return true если файл журнала открыт; если нет, записи выводятся в stderr
+ */
+bool start(const Config& config);
+
+/**
+ * @brief Дописывает накопленные записи и останавливает фоновый поток
+ */
+void stop();
+
+/**
+ * @brief Запускает журнал на время жизни объекта (обычно в main)
+ */
+class Session {
+public:
+    explicit Session(const Config& config) { start(config); }
+    ~Session() { stop(); }
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+};
+
+/**
+ * @brief Устанавливает уровень фильтрации
+ * @param level Минимальный уровень записываемых событий
+ */
+void set_level(Level level);
+
+/**
+ * @brief Текущий уровень фильтрации
+ */
+Level level();
+
+/**
+ * @brief Проверяет, будет ли записано событие уровня level
+ */
+bool enabled(Level level);
+
+/**
+ * @brief Разбирает название уровня (debug|info|warning|error|off)
+ * @param name Название уровня
+ * @param fallback Значение при неизвестном названии
+ */
+Level parse_level(const QString& name, Level fallback);
+
+/**
+ * @brief Количество записей, отброшенных из-за переполнения буфера
+ */
+quint64 dropped();
+
+/**
+ * @brief Запись журнала фиксированного размера
+ *
+ * Строковые поля копируются в UTF-16 с усечением, чтобы не выделять
+ * память в вызывающем потоке.
+ */
+struct Record {
+    static constexpr int kCardSize = 24;    ///< Максимальная длина номера билета
+    static constexpr int kCodeSize = 8;     ///< Максимальная длина кода ошибки SQL
+    static constexpr int kErrorSize = 160;  ///< Максимальная длина текста ошибки SQL
+
+    qint64 timestamp_us;          ///< Время события (мкс с эпохи Unix)
+    Level level;                  ///< Уровень важности
+    const char *operation;        ///< Операция (строковый литерал)
+    const char *message;          ///< Сообщение (строковый литерал UTF-8) или nullptr
+    int book_id;                  ///< ID книги или -1
+    qint64 latency_us;            ///< Длительность операции или -1
+    quint8 card_size;             ///< Длина номера билета
+    quint8 code_size;             ///< Длина кода ошибки SQL
+    quint8 error_size;            ///< Длина текста ошибки SQL
+    char16_t card[kCardSize];     ///< Номер читательского билета
+    char code[kCodeSize];         ///< Код ошибки SQL (SQLSTATE)
+    char16_t error[kErrorSize];   ///< Текст ошибки SQL
+};
+
+/**
+ * @brief Построитель записи; отправляет запись в буфер в деструкторе
+ */
+class Event {
+public:
+    /**
+     * @brief Начинает запись
+     * @param level Уровень важности
+     * @param operation Название операции (строковый литерал)
+     */
+    Event(Level level, const char *operation);
+    ~Event();
+
+    Event(const Event&) = delete;
+    Event& operator=(const Event&) = delete;
+
+    /// @name Поля записи
+    /// @{
+    Event& card(const QString& card_number);
+    Event& book(int book_id);
+    Event& latency_us(qint64 latency);
+    Event& latency(const QElapsedTimer& timer);
+    Event& sql(const QSqlError& error);
+    Event& message(const char *text);
+    /// @}
+
+private:
+    Record record_; ///< Заполняемая запись
+};
+
+} // namespace logging
+
+/// @name Макросы журнала; аргументы не вычисляются, если уровень отфильтрован
+/// @{
+#define LOG_AT(lvl, operation) \
+    if (!::logging::enabled(lvl)) {} else ::logging::Event(lvl, operation)
+#define LOG_DEBUG(operation) LOG_AT(::logging::Level::Debug, operation)
+#define LOG_INFO(operation) LOG_AT(::logging::Level::Info, operation)
+#define LOG_WARNING(operation) LOG_AT(::logging::Level::Warning, operation)
+#define LOG_ERROR(operation) LOG_AT(::logging::Level::Error, operation)
+/// @}
+
+#endif // LOGGER_H
@@ -1,8 +1,14 @@
 #include "mainwindow.h"
 #include "library.h"
+#include "connector.h"
+#include "console.h"
+#include "logger.h"
+#include "tracer.h"
 #include <QApplication>
+#include <QCoreApplication>
 #include <QFile>
 #include <QTextStream>
+#include <QtGlobal>
 
 /**
  * @brief Точка входа в приложение
@@ -10,19 +16,44 @@
  * @param argv Массив аргументов командной строки
  * @return Код возврата приложения
  *
- * @note Выполняет следующие действия:
+ * @note Если первый аргумент — команда консольного режима (см. Console),
+ * приложение выполняет ее без создания окна; остальные аргументы
+ * (например, -style) обрабатывает QApplication.
+ *
+ * В графическом режиме выполняет следующие действия:
  * 1. Создает объект QApplication
  * 2. Загружает и применяет стили из файла style.qss
  * 3. Создает и инициализирует объект Library
- * 4. Подключается к базе данных PostgreSQL
- * 5. Создает и отображает главное окно приложения
- * 6. Запускает главный цикл обработки событий
+ * 4. Создает и отображает главное окно со списками из снимка каталога
+ * 5. Запускает неблокирующую проверку PostgreSQL (DatabaseConnector) и,
+ *    если задана LIBRARY_REPLICA_HOST, реплики для отчетов
+ * 6. Запускает главный цикл обработки событий; когда сервер ответил,
+ *    открывает подключение и дополняет снимок каталога изменениями из базы.
+ *    Пока сервер недоступен, окно работает со снимком, проверка повторяется
  *
  * @warning Путь к файлу стилей жестко закодирован, может потребоваться изменение
  * при переносе приложения на другую систему
  */
 int main(int argc, char *argv[])
 {
+    // Журнал: файл и уровень задаются переменными окружения LIBRARY_LOG_*
+    logging::Session log(logging::Config::from_environment());
+
+    // Трассировка в формате Chrome Trace, если задана LIBRARY_TRACE_FILE
+    tracing::Session trace;
+
+    // Консольный режим для служебных задач (расчет просрочек и т.п.);
+    // прочие аргументы — параметры Qt для графического режима
+    if (argc > 1 && Console::is_command(QString::fromLocal8Bit(argv[1]))) {
+        QCoreApplication app(argc, argv);
+        Library library;
+        if (!library.connect_to_database("localhost", "post", "postgres", "Kirakira8922310")) {
+            return -1;
+        }
+        Console console(&library);
+        return console.run(app.arguments().mid(1));
+    }
+
     // Инициализация Qt-приложения
     QApplication a(argc, argv);
 
@@ -36,15 +67,36 @@ int main(int argc, char *argv[])
 
     // Инициализация библиотечной системы
     Library library;
-    // Подключение к базе данных PostgreSQL
-    if (!library.connect_to_database("localhost", "post", "postgres", "Kirakira8922310")) {
-        return -1; // Возврат с кодом ошибки при неудачном подключении
-    }
 
-    // Создание и отображение главного окна
+    // Главное окно показывает списки из снимка прошлого запуска и работает
+    // с ними, пока нет подключения к базе
     MainWindow w(&library);
     w.show();
 
+    // Подключение к базе данных PostgreSQL: QPSQL открывает подключение
+    // только после того, как сервер ответил на неблокирующую проверку
+    DatabaseConnector primary("localhost", "post", "postgres", "Kirakira8922310");
+    QObject::connect(&primary, &DatabaseConnector::reachable, &w, [&]() {
+        if (!library.connect_to_database("localhost", "post", "postgres", "Kirakira8922310")) {
+            primary.retry_later();
+            w.database_unavailable();
+            return;
+        }
+        w.database_connected();
+    });
+    QObject::connect(&primary, &DatabaseConnector::unreachable, &w, &MainWindow::database_unavailable);
+    primary.start();
+
+    // Реплика для списков и отчетов; без нее все запросы идут на основную БД.
+    // Library проверяет и переподключает ее так же неблокирующе
+    const QString replicaHost = qEnvironmentVariable("LIBRARY_REPLICA_HOST");
+    if (!replicaHost.isEmpty()) {
+        bool ok = false;
+        int staleness = qEnvironmentVariableIntValue("LIBRARY_REPLICA_STALENESS_MS", &ok);
+        staleness = ok ? staleness : 5000;
+        library.connect_to_replica(replicaHost, "post", "postgres", "Kirakira8922310", staleness);
+    }
+
     // Запуск главного цикла обработки событий
     return a.exec();
 }
@@ -1,8 +1,19 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "overdue.h"
+#include "statistics.h"
+#include "statements.h"
+#include "logger.h"
+#include "tracer.h"
 #include <QInputDialog>
-#include <QSqlQuery>
+#include <QMenuBar>
+#include <QActionGroup>
 #include <QMessageBox>
+#include <QStatusBar>
+#include <QStackedWidget>
+#include <QTableView>
+#include <QHeaderView>
+#include <QLayout>
 
 /**
  * @brief Конструктор главного окна
@@ -11,69 +22,182 @@
  */
 MainWindow::MainWindow(Library *lib, QWidget *parent)
     : QMainWindow(parent)
-    , ui(new Ui::MainWindow), library(lib)
+    , ui(new Ui::MainWindow), library(lib), catalog_model(&catalog)
 {
     ui->setupUi(this);
+
+    // Списки каталога показываются моделью поверх снимка, отчеты — таблицей
+    // ui->tableWidget; оба вида занимают ее место в окне
+    catalog_view = new QTableView;
+    catalog_view->setModel(&catalog_model);
+    catalog_view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    catalog_view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    QWidget *tablesParent = ui->tableWidget->parentWidget();
+    tables = new QStackedWidget(tablesParent);
+    QLayoutItem *replaced = tablesParent->layout()
+        ? tablesParent->layout()->replaceWidget(ui->tableWidget, tables) : nullptr;
+    if (replaced) {
+        delete replaced;
+    } else {
+        tables->setGeometry(ui->tableWidget->geometry());
+    }
+    tables->addWidget(ui->tableWidget);
+    tables->addWidget(catalog_view);
+
+    database_actions << menuBar()->addAction("Просрочки", this, SLOT(show_overdue_report()))
+                     << menuBar()->addAction("Популярные книги", this, SLOT(show_top_books()))
+                     << menuBar()->addAction("Активные читатели", this, SLOT(show_active_readers()));
+
+    // Уровень журнала меняется без перезапуска
+    QMenu *logMenu = menuBar()->addMenu("Журнал");
+    QActionGroup *logLevels = new QActionGroup(logMenu);
+    const std::pair<const char *, logging::Level> levels[] = {
+        {"Отладка", logging::Level::Debug},
+        {"Информация", logging::Level::Info},
+        {"Предупреждения", logging::Level::Warning},
+        {"Ошибки", logging::Level::Error},
+    };
+    for (const auto &level : levels) {
+        QAction *action = logMenu->addAction(level.first);
+        action->setCheckable(true);
+        action->setChecked(logging::level() == level.second);
+        logLevels->addAction(action);
+        const logging::Level value = level.second;
+        connect(action, &QAction::triggered, this, [value]() { logging::set_level(value); });
+    }
+
+    // Трассировка: при выключении след сохраняется в файл для Perfetto
+    QAction *traceAction = logMenu->addAction("Трассировка");
+    traceAction->setCheckable(true);
+    traceAction->setChecked(tracing::enabled());
+    connect(traceAction, &QAction::toggled, this, [](bool on) {
+        if (on) {
+            const QString path = tracing::path_from_environment();
+            tracing::start(path.isEmpty() ? QString("library-trace.json") : path);
+        } else {
+            tracing::stop();
+        }
+    });
+
+    // Списки из снимка прошлого запуска доступны до подключения к базе
+    catalog.load(CatalogCache::default_path());
+    show_books();
+    set_online(false);
+    statusBar()->showMessage("Подключение к базе данных...");
 }
 
 /**
  * @brief Деструктор главного окна
+ * @note Сохраняет снимок каталога для быстрого следующего запуска
  */
 MainWindow::~MainWindow()
 {
+    catalog.save(CatalogCache::default_path());
     delete ui;
 }
 
 /**
- * @brief Слот для отображения списка книг
- * @details Заполняет таблицу данными о книгах из базы данных,
- * включая название, автора, категорию и количество доступных экземпляров
+ * @brief Включает операции с базой и дополняет снимок каталога изменениями
+ * @details Вызывается один раз после подключения; сверяет количество
+ * книг и пользователей и обновляет показанный список книг
  */
-void MainWindow::on_ViewBooks_clicked()
+void MainWindow::database_connected()
 {
-    QSqlQuery query("SELECT b.title, a.first_name || ' ' || a.last_name AS author, "
-                    "c.name AS category, b.availability_count FROM books b "
-                    "JOIN authors a ON b.author_id = a.author_id "
-                    "JOIN categories c ON b.category_id = c.category_id");
+    TRACE_SPAN("MainWindow::database_connected", "ui");
+    set_online(true);
+    statusBar()->clearMessage();
+    if (catalog_model.sync(library, true)) {
+        show_books();
+    }
+}
 
-    ui->tableWidget->clear();
-    ui->tableWidget->setRowCount(0);
-    ui->tableWidget->setColumnCount(4);
-    ui->tableWidget->setHorizontalHeaderLabels({"Название", "Автор", "Категория", "Доступно"});
+/**
+ * @brief Сообщает о недоступности базы
+ * @details Показанные списки остаются; подключение повторяется в фоне
+ */
+void MainWindow::database_unavailable()
+{
+    if (!online) {
+        statusBar()->showMessage("Нет подключения к базе данных, показан сохраненный каталог");
+    }
+}
 
-    int row = 0;
-    while (query.next()) {
-        ui->tableWidget->insertRow(row);
-        for (int col = 0; col < 4; ++col) {
-            ui->tableWidget->setItem(row, col, new QTableWidgetItem(query.value(col).toString()));
-        }
-        ++row;
+/**
+ * @brief Включает или выключает действия, которым нужна база
+ * @param value true если подключение открыто
+ * @note Просмотр списков доступен всегда: без базы он показывает снимок
+ */
+void MainWindow::set_online(bool value)
+{
+    online = value;
+    const QList<QWidget *> buttons{ui->AddBook, ui->DeleteBook, ui->GiveBook, ui->ReturnBook,
+                                   ui->AddUser, ui->DeleteUser, ui->Accouting};
+    for (QWidget *button : buttons) {
+        button->setEnabled(value);
+    }
+    for (QAction *action : database_actions) {
+        action->setEnabled(value);
+    }
+}
+
+/**
+ * @brief Слот для отображения списка книг
+ * @details Дополняет снимок каталога изменениями из базы и показывает
+ * название, автора, категорию и количество доступных экземпляров
+ */
+void MainWindow::on_ViewBooks_clicked()
+{
+    TRACE_SPAN("MainWindow::on_ViewBooks_clicked", "ui");
+    if (online) {
+        catalog_model.sync(library, false);
     }
+    show_books();
 }
 
 /**
  * @brief Слот для отображения списка пользователей
- * @details Заполняет таблицу данными о пользователях из базы данных,
- * включая номер библиотечной карточки и ФИО пользователя
+ * @details Дополняет снимок каталога изменениями из базы и показывает
+ * номер библиотечной карточки и ФИО пользователя
  */
 void MainWindow::on_ViewUsers_clicked()
 {
-    QSqlQuery query("SELECT u.library_card_number, u.first_name || ' ' || u.last_name AS user FROM users u");
+    TRACE_SPAN("MainWindow::on_ViewUsers_clicked", "ui");
+    if (online) {
+        catalog_model.sync(library, false);
+    }
+    show_users();
+}
 
-    ui->tableWidget->clear();
-    ui->tableWidget->setRowCount(0);
-    ui->tableWidget->setColumnCount(2);
-    ui->tableWidget->setHorizontalHeaderLabels({"Номер карточки", "Пользователь"});
+/**
+ * @brief Показывает книги из снимка каталога
+ * @note Модель не создает элементов на каждую ячейку, поэтому время не
+ * зависит от размера каталога
+ */
+void MainWindow::show_books()
+{
+    TRACE_SPAN("ui_update", "ui");
+    catalog_model.show(CatalogModel::List::Books);
+    tables->setCurrentWidget(catalog_view);
+}
 
-    int row = 0;
-    while (query.next()) {
-        ui->tableWidget->insertRow(row);
-        ui->tableWidget->setItem(row, 0, new QTableWidgetItem(query.value(0).toString()));
-        ui->tableWidget->setItem(row, 1, new QTableWidgetItem(query.value(1).toString()));
-        ++row;
-    }
-    ui->tableWidget->setColumnWidth(0, 150);
-    ui->tableWidget->setColumnWidth(1, 250);
+/**
+ * @brief Показывает пользователей из снимка каталога
+ */
+void MainWindow::show_users()
+{
+    TRACE_SPAN("ui_update", "ui");
+    catalog_model.show(CatalogModel::List::Users);
+    catalog_view->setColumnWidth(0, 150);
+    catalog_view->setColumnWidth(1, 250);
+    tables->setCurrentWidget(catalog_view);
+}
+
+/**
+ * @brief Показывает таблицу отчетов вместо списка каталога
+ */
+void MainWindow::show_report_table()
+{
+    tables->setCurrentWidget(ui->tableWidget);
 }
 
 /**
@@ -83,6 +207,7 @@ void MainWindow::on_ViewUsers_clicked()
  */
 void MainWindow::on_AddBook_clicked()
 {
+    TRACE_SPAN("MainWindow::on_AddBook_clicked", "ui");
     QString title = QInputDialog::getText(this, "Добавить книгу", "Введите название книги:");
     if (title.isEmpty()) return;
 
@@ -92,6 +217,7 @@ void MainWindow::on_AddBook_clicked()
 
     Book book(title, author, category, availabilityCount);
     if (book.add_book(book)) {
+        library->note_write();
         QMessageBox::information(this, "Успех", "Книга успешно добавлена.");
     } else {
         QMessageBox::critical(this, "Ошибка", "Не удалось добавить книгу.");
@@ -104,10 +230,12 @@ void MainWindow::on_AddBook_clicked()
  */
 void MainWindow::on_DeleteBook_clicked()
 {
+    TRACE_SPAN("MainWindow::on_DeleteBook_clicked", "ui");
     QString title = QInputDialog::getText(this, "Удалить книгу", "Введите название книги:");
     QString author = QInputDialog::getText(this, "Удалить книгу", "Введите автора книги:");
     Book book(title, author, "", 0);
     if (book.delete_book(book)) {
+        library->note_write();
         QMessageBox::information(this, "Успех", "Книга успешно удалена.");
     } else {
         QMessageBox::critical(this, "Ошибка", "Не удалось удалить книгу.");
@@ -121,12 +249,33 @@ void MainWindow::on_DeleteBook_clicked()
  */
 void MainWindow::on_GiveBook_clicked()
 {
+    TRACE_SPAN("MainWindow::on_GiveBook_clicked", "ui");
+    tracing::Span inputSpan("dialog_input", "ui");
     QString title = QInputDialog::getText(this, "Выдать книгу", "Введите название книги:");
     QString author = QInputDialog::getText(this, "Выдать книгу", "Введите автора книги:");
     QString cardNumber = QInputDialog::getText(this, "Выдать книгу", "Введите номер карточки пользователя:");
+    inputSpan.end();
     Book book(title, author, "", 0);
 
-    if (library->issue_book(book, cardNumber)) {
+    // Предупреждение о просрочках по результатам ночного расчета
+    OverdueEngine::ReaderStatus status;
+    tracing::Span overdueSpan("overdue_check");
+    const bool hasOverdue = OverdueEngine(library->database()).reader_status(cardNumber, &status);
+    overdueSpan.end();
+    if (hasOverdue) {
+        QString warning = QString("У читателя %1 просроченных книг (до %2 дн.), пеня %3.\nВыдать книгу?")
+                              .arg(status.overdue_count)
+                              .arg(status.max_days_overdue)
+                              .arg(status.total_fine, 0, 'f', 2);
+        if (QMessageBox::warning(this, "Просрочка", warning, QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
+            return;
+        }
+    }
+
+    const bool issued = library->issue_book(book, cardNumber);
+    // Ожидание, пока пользователь закроет окно, — не обновление интерфейса
+    tracing::Span resultSpan("dialog_result", "ui");
+    if (issued) {
         QMessageBox::information(this, "Успех", "Книга успешно выдана.");
     } else {
         QMessageBox::critical(this, "Ошибка", "Не удалось выдать книгу.");
@@ -140,12 +289,18 @@ void MainWindow::on_GiveBook_clicked()
  */
 void MainWindow::on_ReturnBook_clicked()
 {
+    TRACE_SPAN("MainWindow::on_ReturnBook_clicked", "ui");
+    tracing::Span inputSpan("dialog_input", "ui");
     QString libraryCardNumber = QInputDialog::getText(this, "Вернуть книгу", "Введите номер карточки пользователя:");
     QString title = QInputDialog::getText(this, "Вернуть книгу", "Введите название книги:");
     QString author = QInputDialog::getText(this, "Вернуть книгу", "Введите автора книги:");
+    inputSpan.end();
     Book book(title, author, "", 0);
 
-    if (library->return_book(libraryCardNumber, book)) {
+    const bool returned = library->return_book(libraryCardNumber, book);
+    // Ожидание, пока пользователь закроет окно, — не обновление интерфейса
+    tracing::Span resultSpan("dialog_result", "ui");
+    if (returned) {
         QMessageBox::information(this, "Успех", "Книга успешно возвращена.");
     } else {
         QMessageBox::critical(this, "Ошибка", "Не удалось вернуть книгу.");
@@ -159,12 +314,14 @@ void MainWindow::on_ReturnBook_clicked()
  */
 void MainWindow::on_AddUser_clicked()
 {
+    TRACE_SPAN("MainWindow::on_AddUser_clicked", "ui");
     QString firstName = QInputDialog::getText(this, "Добавить пользователя", "Введите имя:");
     QString lastName = QInputDialog::getText(this, "Добавить пользователя", "Введите фамилию:");
     QString cardNumber = QInputDialog::getText(this, "Добавить пользователя", "Введите номер карточки:");
 
     User user(firstName, lastName, cardNumber);
     if (user.addUser(user)) {
+        library->note_write();
         QMessageBox::information(this, "Успех", "Пользователь успешно добавлен.");
     } else {
         QMessageBox::critical(this, "Ошибка", "Не удалось добавить пользователя.");
@@ -177,9 +334,11 @@ void MainWindow::on_AddUser_clicked()
  */
 void MainWindow::on_DeleteUser_clicked()
 {
+    TRACE_SPAN("MainWindow::on_DeleteUser_clicked", "ui");
     QString cardNumber = QInputDialog::getText(this, "Удалить пользователя", "Введите номер карточки пользователя для удаления:");
     User user("", "", cardNumber);
     if (user.deleteUser(cardNumber)) {
+        library->note_write();
         QMessageBox::information(this, "Успех", "Пользователь успешно удален.");
     } else {
         QMessageBox::critical(this, "Ошибка", "Не удалось удалить пользователя.");
@@ -193,13 +352,11 @@ void MainWindow::on_DeleteUser_clicked()
  */
 void MainWindow::on_Accouting_clicked()
 {
-    QSqlQuery query("SELECT u.library_card_number, u.first_name || ' ' || u.last_name AS user, "
-                    "b.title, a.first_name || ' ' || a.last_name AS author, "
-                    "bl.loan_date, bl.return_date FROM book_loans bl "
-                    "JOIN books b ON bl.book_id = b.book_id "
-                    "JOIN authors a ON b.author_id = a.author_id "
-                    "JOIN users u ON bl.user_id = u.user_id");
+    TRACE_SPAN("MainWindow::on_Accouting_clicked", "ui");
+    auto query = library->read<stmt::ListLoans>();
 
+    TRACE_SPAN("ui_update", "ui");
+    show_report_table();
     ui->tableWidget->clear();
     ui->tableWidget->setRowCount(0);
     ui->tableWidget->setColumnCount(6);
@@ -207,10 +364,112 @@ void MainWindow::on_Accouting_clicked()
 
     int row = 0;
     while (query.next()) {
+        const auto loan = query.row();
         ui->tableWidget->insertRow(row);
-        for (int col = 0; col < 6; ++col) {
-            ui->tableWidget->setItem(row, col, new QTableWidgetItem(query.value(col).toString()));
-        }
+        ui->tableWidget->setItem(row, 0, new QTableWidgetItem(loan.card_number));
+        ui->tableWidget->setItem(row, 1, new QTableWidgetItem(loan.user));
+        ui->tableWidget->setItem(row, 2, new QTableWidgetItem(loan.title));
+        ui->tableWidget->setItem(row, 3, new QTableWidgetItem(loan.author));
+        ui->tableWidget->setItem(row, 4, new QTableWidgetItem(loan.loan_date.toString(Qt::ISODate)));
+        ui->tableWidget->setItem(row, 5, new QTableWidgetItem(
+            loan.return_date ? loan.return_date->toString(Qt::ISODate) : QString()));
+        ++row;
+    }
+}
+
+/**
+ * @brief Слот для отображения отчета о просрочках
+ * @details Показывает результаты последнего ночного расчета просрочек:
+ * читателя, книгу, срок возврата, количество дней просрочки и пеню
+ */
+void MainWindow::show_overdue_report()
+{
+    TRACE_SPAN("MainWindow::show_overdue_report", "ui");
+    // Отчет только читает результат ночного расчета, поэтому может идти с реплики
+    auto query = library->read<stmt::OverdueReport>();
+    if (!query.ok()) {
+        LOG_ERROR("overdue_report").sql(query.error()).message("ошибка построения отчета");
+    }
+
+    TRACE_SPAN("ui_update", "ui");
+    show_report_table();
+    ui->tableWidget->clear();
+    ui->tableWidget->setRowCount(0);
+    ui->tableWidget->setColumnCount(6);
+    ui->tableWidget->setHorizontalHeaderLabels({"Номер карточки", "Пользователь", "Книга", "Срок возврата", "Дней просрочки", "Пеня"});
+
+    int row = 0;
+    while (query.next()) {
+        const auto overdue = query.row();
+        ui->tableWidget->insertRow(row);
+        ui->tableWidget->setItem(row, 0, new QTableWidgetItem(overdue.card_number));
+        ui->tableWidget->setItem(row, 1, new QTableWidgetItem(overdue.user));
+        ui->tableWidget->setItem(row, 2, new QTableWidgetItem(overdue.title));
+        ui->tableWidget->setItem(row, 3, new QTableWidgetItem(overdue.due_date.toString(Qt::ISODate)));
+        ui->tableWidget->setItem(row, 4, new QTableWidgetItem(QString::number(overdue.days_overdue)));
+        ui->tableWidget->setItem(row, 5, new QTableWidgetItem(QString::number(overdue.fine, 'f', 2)));
+        ++row;
+    }
+}
+
+/**
+ * @brief Слот для отображения самых выдаваемых книг
+ * @details Показывает по пять самых выдаваемых книг каждой категории
+ * с начала текущего месяца
+ */
+void MainWindow::show_top_books()
+{
+    TRACE_SPAN("MainWindow::show_top_books", "ui");
+    const QDate today = QDate::currentDate();
+    const QDate monthStart(today.year(), today.month(), 1);
+    auto query = CirculationStats(library).top_books(monthStart, today.addDays(1), 5);
+
+    TRACE_SPAN("ui_update", "ui");
+    show_report_table();
+    ui->tableWidget->clear();
+    ui->tableWidget->setRowCount(0);
+    ui->tableWidget->setColumnCount(4);
+    ui->tableWidget->setHorizontalHeaderLabels({"Категория", "Книга", "Автор", "Выдач за месяц"});
+
+    int row = 0;
+    while (query.next()) {
+        const auto top = query.row();
+        ui->tableWidget->insertRow(row);
+        ui->tableWidget->setItem(row, 0, new QTableWidgetItem(top.category));
+        ui->tableWidget->setItem(row, 1, new QTableWidgetItem(top.title));
+        ui->tableWidget->setItem(row, 2, new QTableWidgetItem(top.author));
+        ui->tableWidget->setItem(row, 3, new QTableWidgetItem(QString::number(top.issues)));
+        ++row;
+    }
+}
+
+/**
+ * @brief Слот для отображения активных читателей
+ * @details Показывает читателей, у которых сейчас есть книги на руках,
+ * начиная с тех, у кого их больше всего
+ */
+void MainWindow::show_active_readers()
+{
+    TRACE_SPAN("MainWindow::show_active_readers", "ui");
+    auto query = CirculationStats(library).active_readers();
+
+    TRACE_SPAN("ui_update", "ui");
+    show_report_table();
+    ui->tableWidget->clear();
+    ui->tableWidget->setRowCount(0);
+    ui->tableWidget->setColumnCount(5);
+    ui->tableWidget->setHorizontalHeaderLabels({"Номер карточки", "Пользователь", "На руках", "Всего выдач", "Последняя выдача"});
+
+    int row = 0;
+    while (query.next()) {
+        const auto reader = query.row();
+        ui->tableWidget->insertRow(row);
+        ui->tableWidget->setItem(row, 0, new QTableWidgetItem(reader.card_number));
+        ui->tableWidget->setItem(row, 1, new QTableWidgetItem(reader.user));
+        ui->tableWidget->setItem(row, 2, new QTableWidgetItem(QString::number(reader.current_loans)));
+        ui->tableWidget->setItem(row, 3, new QTableWidgetItem(QString::number(reader.total_loans)));
+        ui->tableWidget->setItem(row, 4, new QTableWidgetItem(
+            reader.last_loan_date ? reader.last_loan_date->toString(Qt::ISODate) : QString()));
         ++row;
     }
 }
@@ -6,6 +6,11 @@
 #include "book.h"
 #include "user.h"
 #include "library.h"
+#include "catalogcache.h"
+#include "catalogmodel.h"
+
+class QStackedWidget;
+class QTableView;
 
 namespace Ui {
 class MainWindow;
@@ -37,6 +42,18 @@ public:
      */
     ~MainWindow();
 
+    /**
+     * @brief Включает операции с базой и дополняет снимок каталога изменениями
+     * @note Вызывается после успешного подключения к базе
+     */
+    void database_connected();
+
+public slots:
+    /**
+     * @brief Сообщает, что база недоступна; окно продолжает работать со снимком
+     */
+    void database_unavailable();
+
 private slots:
     /// @name Слоты для обработки действий пользователя
     /// @{
@@ -84,11 +101,49 @@ private slots:
      * @brief Открывает отчет по учету операций
      */
     void on_Accouting_clicked();
+
+    /**
+     * @brief Открывает отчет о просрочках по результатам ночного расчета
+     */
+    void show_overdue_report();
+
+    /**
+     * @brief Открывает статистику самых выдаваемых книг по категориям за текущий месяц
+     */
+    void show_top_books();
+
+    /**
+     * @brief Открывает список читателей с книгами на руках
+     */
+    void show_active_readers();
     /// @}
 
 private:
-    Ui::MainWindow *ui; ///< Указатель на сгенерированный UI-класс
-    Library *library;   ///< Указатель на объект работы с библиотекой
+    /// @name Показ списков из снимка каталога (через CatalogModel)
+    /// @{
+    void show_books();
+    void show_users();
+    /// @}
+
+    /**
+     * @brief Показывает таблицу отчетов вместо списка каталога
+     */
+    void show_report_table();
+
+    /**
+     * @brief Включает или выключает действия, которым нужна база
+     * @param value true если подключение открыто
+     */
+    void set_online(bool value);
+
+    Ui::MainWindow *ui;    ///< Указатель на сгенерированный UI-класс
+    Library *library;      ///< Указатель на объект работы с библиотекой
+    CatalogCache catalog;  ///< Снимок книг и пользователей (сохраняется при выходе)
+    CatalogModel catalog_model;  ///< Книги или пользователи из снимка
+    QTableView *catalog_view;    ///< Список каталога (модель читает снимок по видимым строкам)
+    QStackedWidget *tables;      ///< Список каталога или таблица отчетов ui->tableWidget
+    bool online = false;   ///< Подключение к базе открыто
+    QList<QAction*> database_actions;  ///< Пункты меню, которым нужна база
 };
 
 #endif // MAINWINDOW_H
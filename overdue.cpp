@@ -0,0 +1,122 @@
+#include "overdue.h"
+#include "logger.h"
+#include "tracer.h"
+#include <QSqlError>
+#include <QElapsedTimer>
+
+/**
+ * @brief Конструктор
+ * @param db Подключение к базе данных
+ */
+OverdueEngine::OverdueEngine(const QSqlDatabase &db)
+    : db_(db)
+{
+}
+
+/**
+ * @brief Пересчитывает просрочки на заданную дату
+ * @param as_of Дата расчета
+ * @param stats Итоги расчета (может быть nullptr)
+ * @return true при успехе, false при ошибке
+ * @note Выполняет следующие действия в одной транзакции:
+ * 1. Очищает результаты предыдущего расчета (DELETE, а не TRUNCATE,
+ *    чтобы не блокировать чтение сводки кафедрами на время расчета)
+ * 2. Вставляет просроченные выдачи одним INSERT ... SELECT
+ *    (stmt::ComputeOverdueLoans) по частичному индексу открытых выдач
+ * 3. Агрегирует сводку по читателям
+ */
+bool OverdueEngine::run(const QDate &as_of, RunStats *stats)
+{
+    TRACE_SPAN("OverdueEngine::run");
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!db_.transaction()) {
+        LOG_ERROR("overdue_run").sql(db_.lastError()).message("ошибка начала транзакции");
+        return false;
+    }
+
+    sql::StatementCache &statements = sql::cache_for(db_);
+
+    auto clearReaders = statements.exec<stmt::ClearOverdueReaders>();
+    auto clearLoans = statements.exec<stmt::ClearOverdueLoans>();
+    if (!clearReaders.ok() || !clearLoans.ok()) {
+        LOG_ERROR("overdue_run").sql(clearReaders.ok() ? clearLoans.error() : clearReaders.error())
+            .message("ошибка очистки результатов просрочек");
+        db_.rollback();
+        return false;
+    }
+
+    auto loansQuery = statements.exec<stmt::ComputeOverdueLoans>(as_of, kDefaultLoanDays, kDefaultDailyFine);
+    if (!loansQuery.ok()) {
+        LOG_ERROR("overdue_run").sql(loansQuery.error()).message("ошибка расчета просроченных выдач");
+        db_.rollback();
+        return false;
+    }
+    const int overdueLoans = loansQuery.rows_affected();
+
+    auto readersQuery = statements.exec<stmt::ComputeOverdueReaders>();
+    if (!readersQuery.ok()) {
+        LOG_ERROR("overdue_run").sql(readersQuery.error()).message("ошибка расчета сводки по читателям");
+        db_.rollback();
+        return false;
+    }
+    const int readers = readersQuery.rows_affected();
+
+    if (!db_.commit()) {
+        LOG_ERROR("overdue_run").sql(db_.lastError()).message("ошибка фиксации транзакции");
+        return false;
+    }
+
+    LOG_INFO("overdue_run").latency(timer);
+
+    if (stats) {
+        stats->overdue_loans = overdueLoans;
+        stats->readers = readers;
+        stats->elapsed_ms = timer.elapsed();
+    }
+    return true;
+}
+
+/**
+ * @brief Читает сводку по читателю
+ * @param card_number Номер читательского билета
+ * @param status Сводка по читателю
+ * @return true если у читателя есть просрочки, false если нет или при ошибке
+ * @note Один поиск по уникальному номеру билета и первичному ключу сводки
+ */
+bool OverdueEngine::reader_status(const QString &card_number, ReaderStatus *status)
+{
+    auto query = sql::cache_for(db_).exec<stmt::ReaderOverdueStatus>(card_number);
+    if (!query.ok()) {
+        LOG_ERROR("overdue_status").card(card_number).sql(query.error()).message("ошибка чтения сводки просрочек");
+        return false;
+    }
+    if (!query.next()) {
+        return false;
+    }
+
+    if (status) {
+        const auto row = query.row();
+        status->overdue_count = row.overdue_count;
+        status->max_days_overdue = row.max_days_overdue;
+        status->total_fine = row.total_fine;
+        status->computed_on = row.computed_on;
+    }
+    return true;
+}
+
+/**
+ * @brief Отчет о просрочках
+ * @return Результат запроса
+ * @note Читает готовую таблицу overdue_loans по индексу days_overdue,
+ * соединяя с книгами и читателями по первичным ключам
+ */
+sql::Result<stmt::OverdueReport> OverdueEngine::report()
+{
+    auto query = sql::cache_for(db_).exec<stmt::OverdueReport>();
+    if (!query.ok()) {
+        LOG_ERROR("overdue_report").sql(query.error()).message("ошибка построения отчета");
+    }
+    return query;
+}
@@ -0,0 +1,76 @@
+#ifndef OVERDUE_H
+#define OVERDUE_H
+
+#include <QDate>
+#include <QString>
+#include <QSqlDatabase>
+#include "statements.h"
+
+/**
+ * @brief Ночной расчет просрочек и пеней
+ *
+ * Срок выдачи и пеня за день задаются по категориям в таблице
+ * loan_policies. Расчет выполняется одним набором SQL-операторов по
+ * частичному индексу открытых выдач и сохраняет результат в таблицы
+ * overdue_loans и overdue_readers, так что предупреждение на кафедре
+ * и отчет о просрочках читают готовые данные по индексу.
+ */
+class OverdueEngine {
+public:
+    /// Срок выдачи по умолчанию (дней) для категорий без политики
+    static constexpr int kDefaultLoanDays = 14;
+    /// Пеня за день просрочки по умолчанию
+    static constexpr double kDefaultDailyFine = 5.0;
+
+    /**
+     * @brief Итоги одного расчета
+     */
+    struct RunStats {
+        int overdue_loans = 0;  ///< Количество просроченных выдач
+        int readers = 0;        ///< Количество читателей с просрочками
+        qint64 elapsed_ms = 0;  ///< Длительность расчета
+    };
+
+    /**
+     * @brief Сводка по читателю для кафедры выдачи
+     */
+    struct ReaderStatus {
+        int overdue_count = 0;     ///< Количество просроченных книг
+        int max_days_overdue = 0;  ///< Наибольшая просрочка в днях
+        double total_fine = 0.0;   ///< Сумма пеней
+        QDate computed_on;         ///< Дата расчета
+    };
+
+    /**
+     * @brief Конструктор
+     * @param db Подключение к базе данных
+     */
+    explicit OverdueEngine(const QSqlDatabase& db);
+
+    /**
+     * @brief Пересчитывает просрочки на заданную дату
+     * @param as_of Дата, на которую считается просрочка
+     * @param stats Итоги расчета (может быть nullptr)
+     * @return true если расчет зафиксирован
+     */
+    bool run(const QDate& as_of, RunStats* stats = nullptr);
+
+    /**
+     * @brief Читает сводку по читателю из результатов последнего расчета
+     * @param card_number Номер читательского билета
+     * @param status Сводка; заполняется только при наличии просрочек
+     * @return true если у читателя есть просрочки
+     */
+    bool reader_status(const QString& card_number, ReaderStatus* status);
+
+    /**
+     * @brief Отчет о просрочках, от наибольшей к наименьшей
+     * @return Результат запроса stmt::OverdueReport
+     */
+    sql::Result<stmt::OverdueReport> report();
+
+private:
+    QSqlDatabase db_; ///< Подключение к базе данных
+};
+
+#endif // OVERDUE_H
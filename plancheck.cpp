@@ -0,0 +1,420 @@
+#include "plancheck.h"
+#include "overdue.h"
+#include "logger.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+
+/**
+ * @brief Конструктор
+ * @param db Подключение к базе данных
+ * @param out Поток для отчета
+ */
+PlanCheck::PlanCheck(const QSqlDatabase &db, QTextStream &out)
+    : db_(db), out_(out)
+{
+}
+
+/**
+ * @brief Проверяет все операторы
+ * @param baselines_path Файл базовых стоимостей
+ * @param update true — записать текущие стоимости как базовые
+ * @return true если все проверки пройдены
+ * @note В режиме update файл не перезаписывается, если хоть одна
+ * проверка не пройдена (ошибка EXPLAIN или Seq Scan по большой таблице)
+ * @note Перед проверкой выполняет VACUUM ANALYZE, чтобы планы не зависели
+ * от того, успел ли отработать autovacuum: откатываемые проверки пишущих
+ * операторов (ComputeOverdueLoans и др.) оставляют мертвые строки, и без
+ * очистки стоимость сканирования этих таблиц росла бы с каждым прогоном
+ */
+bool PlanCheck::run(const QString &baselines_path, bool update)
+{
+    QSqlQuery analyze(db_);
+    if (!analyze.exec("VACUUM ANALYZE")) {
+        LOG_ERROR("plan_check").sql(analyze.lastError()).message("ошибка обновления статистики");
+        return false;
+    }
+
+    Sample sample;
+    if (!load_table_sizes() || !load_sample(&sample)) {
+        return false;
+    }
+    build_cases(sample);
+
+    QMap<QString, double> baselines;
+    if (!update && !read_baselines(baselines_path, &baselines)) {
+        out_ << "Нет файла базовых стоимостей " << baselines_path
+             << ", запишите его командой plan-check --update" << Qt::endl;
+        return false;
+    }
+
+    bool passed = true;
+    QMap<QString, double> current;
+    for (const Case &item : cases_) {
+        // Общий план отличается от плана под значения только у операторов с параметрами
+        for (const bool generic : {false, true}) {
+            if (generic && item.params.isEmpty()) {
+                continue;
+            }
+            const QString name = generic ? item.name + "/generic" : item.name;
+            Plan plan;
+            if (!explain(item, generic, &plan)) {
+                out_ << name << "\tОШИБКА EXPLAIN" << Qt::endl;
+                passed = false;
+                continue;
+            }
+            current.insert(name, plan.total_cost);
+            check(name, item, plan, baselines, update, &passed);
+        }
+    }
+
+    if (update) {
+        // Неполный или зафиксировавший плохой план файл проваливал бы все следующие прогоны
+        if (!passed) {
+            out_ << "Базовые стоимости не записаны: есть непройденные проверки" << Qt::endl;
+            return false;
+        }
+        return write_baselines(baselines_path, current);
+    }
+    return passed;
+}
+
+/**
+ * @brief Сверяет план с правилами и базовой стоимостью и выводит строку отчета
+ * @param name Имя проверки (имя оператора и режим плана)
+ * @param item Оператор
+ * @param plan Разобранный план
+ * @param baselines Базовые стоимости
+ * @param update true — базовые стоимости перезаписываются и не сравниваются
+ * @param passed Сбрасывается в false при нарушении
+ */
+void PlanCheck::check(const QString &name, const Case &item, const Plan &plan,
+                      const QMap<QString, double> &baselines, bool update, bool *passed)
+{
+    QStringList problems;
+    for (const QString &table : plan.seq_scans) {
+        if (table_rows_.value(table) >= kLargeTableRows && !item.full_scans.contains(table)) {
+            problems << QString("Seq Scan по %1").arg(table);
+        }
+    }
+    if (!update) {
+        if (!baselines.contains(name)) {
+            problems << "нет базовой стоимости";
+        } else if (plan.total_cost > baselines.value(name) * (1.0 + kCostTolerance)) {
+            problems << QString("стоимость %1 > базовой %2")
+                            .arg(plan.total_cost, 0, 'f', 2)
+                            .arg(baselines.value(name), 0, 'f', 2);
+        }
+    }
+
+    out_ << name << "\tcost=" << QString::number(plan.total_cost, 'f', 2)
+         << "\ttime=" << QString::number(plan.execution_ms, 'f', 3) << " мс"
+         << "\tbuffers hit=" << plan.shared_hit << " read=" << plan.shared_read << '\t'
+         << (problems.isEmpty() ? QString("OK") : "FAIL: " + problems.join("; ")) << Qt::endl;
+    *passed = *passed && problems.isEmpty();
+}
+
+/**
+ * @brief Строковый литерал SQL
+ */
+QString PlanCheck::literal(const QString &value)
+{
+    QString escaped = value;
+    escaped.replace(QLatin1Char('\''), QLatin1String("''"));
+    return QLatin1Char('\'') + escaped + QLatin1Char('\'');
+}
+
+/**
+ * @brief Целочисленный литерал SQL
+ */
+QString PlanCheck::literal(int value)
+{
+    return QString::number(value);
+}
+
+/**
+ * @brief Целочисленный литерал SQL (bigint)
+ */
+QString PlanCheck::literal(qint64 value)
+{
+    return QString::number(value);
+}
+
+/**
+ * @brief Дробный литерал SQL
+ */
+QString PlanCheck::literal(double value)
+{
+    return QString::number(value, 'g', 17);
+}
+
+/**
+ * @brief Литерал даты SQL
+ */
+QString PlanCheck::literal(const QDate &value)
+{
+    return QString("DATE '%1'").arg(value.toString(Qt::ISODate));
+}
+
+/**
+ * @brief Выбирает из базы книгу, читателя и открытую выдачу для параметров
+ * @param sample Заполняемые значения
+ * @return false если база пуста или запрос не выполнен
+ */
+bool PlanCheck::load_sample(Sample *sample)
+{
+    QSqlQuery query(db_);
+    if (!query.exec("SELECT b.book_id, b.author_id, b.category_id, b.title, "
+                    "a.first_name || ' ' || a.last_name, c.name FROM books b "
+                    "JOIN authors a ON a.author_id = b.author_id "
+                    "JOIN categories c ON c.category_id = b.category_id "
+                    "ORDER BY b.book_id DESC LIMIT 1")
+        || !query.next()) {
+        LOG_ERROR("plan_check").sql(query.lastError()).message("в базе нет книг");
+        return false;
+    }
+    sample->book_id = query.value(0).toInt();
+    sample->author_id = query.value(1).toInt();
+    sample->category_id = query.value(2).toInt();
+    sample->title = query.value(3).toString();
+    sample->author = query.value(4).toString();
+    sample->category = query.value(5).toString();
+
+    if (!query.exec("SELECT user_id, library_card_number FROM users ORDER BY user_id DESC LIMIT 1")
+        || !query.next()) {
+        LOG_ERROR("plan_check").sql(query.lastError()).message("в базе нет читателей");
+        return false;
+    }
+    sample->user_id = query.value(0).toInt();
+    sample->card_number = query.value(1).toString();
+
+    if (!query.exec("SELECT loan_id, book_id, user_id FROM book_loans WHERE return_date IS NULL LIMIT 1")
+        || !query.next()) {
+        LOG_ERROR("plan_check").sql(query.lastError()).message("в базе нет открытых выдач");
+        return false;
+    }
+    sample->loan_id = query.value(0).toInt();
+    sample->loan_book_id = query.value(1).toInt();
+    sample->loan_user_id = query.value(2).toInt();
+
+    // Дата расчетов и момент дельты каталога берутся из набора, а не из часов,
+    // чтобы стоимости на одном наборе не зависели от дня запуска
+    if (!query.exec("SELECT MAX(loan_date), "
+                    "CAST(EXTRACT(EPOCH FROM (SELECT MAX(updated_at) FROM books)) * 1000 AS bigint) "
+                    "FROM book_loans")
+        || !query.next()) {
+        LOG_ERROR("plan_check").sql(query.lastError()).message("ошибка чтения даты набора");
+        return false;
+    }
+    sample->reference_day = query.value(0).toDate();
+    sample->catalog_clock_ms = query.value(1).toLongLong();
+    return true;
+}
+
+/**
+ * @brief Составляет список проверяемых операторов
+ * @param s Значения параметров
+ * @note Новый оператор в statements.h нужно добавить и сюда; для
+ * удаления используются несуществующие ключи, чтобы откат был дешевым
+ */
+void PlanCheck::build_cases(const Sample &s)
+{
+    const QDate today = s.reference_day;
+    const QString missing = QStringLiteral("plan-check");
+    cases_.clear();
+
+    // Книги и авторы
+    add<stmt::FindBook>({}, s.title, s.author);
+    add<stmt::AdjustAvailability>({}, 0, s.book_id);
+    add<stmt::FindAuthor>({}, s.author);
+    add<stmt::FindCategory>({}, s.category);
+    add<stmt::InsertBook>({}, missing, s.author_id, s.category_id, 1);
+    add<stmt::DeleteBook>({}, missing, s.author);
+
+    // Пользователи
+    add<stmt::FindUser>({}, s.card_number);
+    add<stmt::InsertUser>({}, missing, missing, missing);
+    add<stmt::DeleteUser>({}, missing);
+
+    // Выдачи
+    add<stmt::InsertLoan>({}, s.book_id, s.user_id);
+    add<stmt::FindOpenLoan>({}, s.loan_book_id, s.loan_user_id);
+    add<stmt::CloseLoan>({}, s.loan_id);
+    add<stmt::ListLoans>({"book_loans", "books", "authors", "users"});
+
+    // Кеш каталога: полная загрузка читает таблицы целиком, дельта — по updated_at
+    // (рабочее место, получившее последние изменения набора)
+    const qint64 syncedAt = s.catalog_clock_ms + 1;
+    add<stmt::CatalogClock>({});
+    add<stmt::CatalogBooks>({"books", "authors", "categories"});
+    add<stmt::CatalogBooksSince>({}, syncedAt);
+    add<stmt::CatalogUsersSince>({"users"}, qint64(0));
+    cases_.back().name += "/full";
+    add<stmt::CatalogUsersSince>({}, syncedAt);
+    cases_.back().name += "/delta";
+    add<stmt::CatalogDeletionsSince>({}, syncedAt);
+    add<stmt::CatalogCounts>({"books", "users"});
+
+    // Служебные
+    add<stmt::WalPosition>({});
+
+    // Сверка фонда
+    const QString bookArray = QString("{%1}").arg(s.book_id);
+    add<stmt::BookIdRange>({});
+    add<stmt::FindAvailabilityDrift>({}, s.book_id - 10000, s.book_id, s.book_id - 10000, s.book_id);
+    add<stmt::SetLockTimeout>({}, QStringLiteral("2000ms"));
+    add<stmt::LockBooks>({}, bookArray);
+    add<stmt::RepairAvailability>({}, bookArray);
+
+    // Просрочки
+    add<stmt::ClearOverdueReaders>({"overdue_readers"});
+    add<stmt::ClearOverdueLoans>({"overdue_loans"});
+    add<stmt::ComputeOverdueLoans>({"books"}, today, OverdueEngine::kDefaultLoanDays,
+                                   OverdueEngine::kDefaultDailyFine);
+    // Расчет вставляет строки заново, как после очистки в OverdueEngine::run
+    cases_.back().setup = "DELETE FROM overdue_loans";
+    add<stmt::ComputeOverdueReaders>({"overdue_loans"});
+    cases_.back().setup = "DELETE FROM overdue_readers";
+    add<stmt::ReaderOverdueStatus>({}, s.card_number);
+    add<stmt::OverdueReport>({"overdue_loans", "users", "books"});
+    add<stmt::LoanCounts>({"book_loans"});
+
+    // Статистика
+    add<stmt::TopBooks>({"books", "authors"}, QDate(today.year(), today.month(), 1), today.addDays(1), 5);
+    add<stmt::ActiveReaders>({"users"});
+}
+
+/**
+ * @brief Подготавливает оператор и выполняет EXPLAIN ANALYZE EXECUTE в откатываемой транзакции
+ * @param item Оператор
+ * @param generic true — общий план (force_generic_plan), false — план под значения параметров
+ * @param plan Разобранный план
+ * @return true при успехе
+ * @note Подготовленный оператор не удаляется откатом, поэтому после
+ * транзакции освобождается явно (DEALLOCATE)
+ */
+bool PlanCheck::explain(const Case &item, bool generic, Plan *plan)
+{
+    if (!db_.transaction()) {
+        LOG_ERROR("plan_check").sql(db_.lastError()).message("ошибка начала транзакции");
+        return false;
+    }
+    const QString mode = generic ? "force_generic_plan" : "force_custom_plan";
+    const QString execute = item.params.isEmpty()
+        ? QString("EXECUTE plan_check")
+        : QString("EXECUTE plan_check (%1)").arg(item.params.join(", "));
+    QSqlQuery query(db_);
+    const bool ok = query.exec("SET LOCAL plan_cache_mode = " + mode)
+        && (item.setup.isEmpty() || query.exec(item.setup))
+        && query.exec("PREPARE plan_check AS " + item.sql)
+        && query.exec("EXPLAIN (ANALYZE, BUFFERS, FORMAT JSON) " + execute) && query.next();
+    const QByteArray json = ok ? query.value(0).toString().toUtf8() : QByteArray();
+    if (!ok) {
+        LOG_ERROR("plan_check").sql(query.lastError()).message("ошибка EXPLAIN");
+    }
+    query.finish();
+    db_.rollback();
+    // Ошибка означает, что оператор не был подготовлен
+    query.exec("DEALLOCATE plan_check");
+    if (!ok) {
+        return false;
+    }
+
+    const QJsonObject root = QJsonDocument::fromJson(json).array().at(0).toObject();
+    const QJsonObject top = root.value("Plan").toObject();
+    plan->total_cost = top.value("Total Cost").toDouble();
+    plan->execution_ms = root.value("Execution Time").toDouble();
+    plan->shared_hit = qint64(top.value("Shared Hit Blocks").toDouble());
+    plan->shared_read = qint64(top.value("Shared Read Blocks").toDouble());
+    plan->seq_scans.clear();
+    collect_seq_scans(top, &plan->seq_scans);
+    return !top.isEmpty();
+}
+
+/**
+ * @brief Собирает таблицы, читаемые последовательным сканированием, по всему дереву плана
+ */
+void PlanCheck::collect_seq_scans(const QJsonObject &node, QStringList *tables) const
+{
+    if (node.value("Node Type").toString() == "Seq Scan") {
+        const QString table = node.value("Relation Name").toString();
+        if (!tables->contains(table)) {
+            tables->append(table);
+        }
+    }
+    for (const QJsonValue &child : node.value("Plans").toArray()) {
+        collect_seq_scans(child.toObject(), tables);
+    }
+}
+
+/**
+ * @brief Читает оценку числа строк таблиц схемы public
+ * @return true при успехе
+ */
+bool PlanCheck::load_table_sizes()
+{
+    QSqlQuery query(db_);
+    if (!query.exec("SELECT relname, reltuples FROM pg_class "
+                    "WHERE relkind = 'r' AND relnamespace = 'public'::regnamespace")) {
+        LOG_ERROR("plan_check").sql(query.lastError()).message("ошибка чтения размеров таблиц");
+        return false;
+    }
+    table_rows_.clear();
+    while (query.next()) {
+        table_rows_.insert(query.value(0).toString(), query.value(1).toDouble());
+    }
+    return true;
+}
+
+/**
+ * @brief Читает базовые стоимости
+ * @param path Файл: строки "имя<TAB>стоимость", строки с # — комментарии
+ * @param baselines Прочитанные стоимости
+ * @return false если файл не открыт
+ */
+bool PlanCheck::read_baselines(const QString &path, QMap<QString, double> *baselines)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        return false;
+    }
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+        const QStringList fields = line.split(QLatin1Char('\t'));
+        if (fields.size() == 2) {
+            baselines->insert(fields[0], fields[1].toDouble());
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Записывает базовые стоимости
+ * @param path Файл
+ * @param baselines Стоимости по именам операторов
+ * @return true если файл записан
+ */
+bool PlanCheck::write_baselines(const QString &path, const QMap<QString, double> &baselines)
+{
+    QFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate | QFile::Text)) {
+        LOG_ERROR("plan_check").message("не удалось записать файл базовых стоимостей");
+        return false;
+    }
+    QTextStream stream(&file);
+    stream << "# Базовые оценки стоимости планов (EXPLAIN Total Cost).\n"
+           << "# Набор: library generate --seed 1 --today 2026-01-01 (размеры по умолчанию)\n"
+           << "# Обновляются только явно: library plan-check --update\n";
+    for (auto it = baselines.constBegin(); it != baselines.constEnd(); ++it) {
+        stream << it.key() << '\t' << QString::number(it.value(), 'f', 2) << '\n';
+    }
+    out_ << "Базовые стоимости записаны в " << path << Qt::endl;
+    return true;
+}
@@ -0,0 +1,148 @@
+#ifndef PLANCHECK_H
+#define PLANCHECK_H
+
+#include <QDate>
+#include <QJsonObject>
+#include <QMap>
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <vector>
+#include "statements.h"
+
+/**
+ * @brief Проверка планов выполнения SQL-операторов приложения
+ *
+ * Каждый оператор из statements.h подготавливается так же, как его
+ * подготавливает драйвер QPSQL (`PREPARE ... AS` с параметрами $n), и
+ * выполняется через `EXPLAIN (ANALYZE, BUFFERS, FORMAT JSON) EXECUTE`
+ * в двух режимах кеша планов: с планом под конкретные значения
+ * (force_custom_plan, имя оператора) и с общим планом, на который
+ * PostgreSQL переходит после нескольких выполнений подготовленного
+ * оператора (force_generic_plan, имя с суффиксом "/generic"; только для
+ * операторов с параметрами). Проверка считается непройденной, если:
+ * - план читает последовательным сканированием большую таблицу,
+ *   которая не указана для оператора как читаемая целиком;
+ * - оценка стоимости плана превышает базовую больше чем на kCostTolerance.
+ *
+ * Базовые стоимости хранятся в файле (plan_baselines.tsv) и обновляются
+ * только явно, командой `plan-check --update`, на наборе
+ * `generate --seed 1 --today 2026-01-01` с размерами по умолчанию.
+ * Значения параметров и дата расчета берутся из данных, а не из текущего
+ * времени, поэтому на одном наборе прогоны сравнимы. Изменяющие операторы
+ * выполняются в транзакции, которая откатывается после каждого EXPLAIN.
+ */
+class PlanCheck {
+public:
+    /// Таблица считается большой начиная с этого числа строк (pg_class.reltuples)
+    static constexpr double kLargeTableRows = 10000;
+    /// Допустимый рост стоимости плана относительно базовой
+    static constexpr double kCostTolerance = 0.20;
+
+    /**
+     * @brief Конструктор
+     * @param db Подключение к базе данных с загруженным набором данных
+     * @param out Поток для отчета
+     */
+    PlanCheck(const QSqlDatabase& db, QTextStream& out);
+
+    /**
+     * @brief Проверяет все операторы
+     * @param baselines_path Файл базовых стоимостей
+     * @param update true — записать текущие стоимости как базовые вместо сравнения
+     * @return true если все проверки пройдены (при update — и базовые стоимости
+     *         записаны; при непройденных проверках файл не изменяется)
+     */
+    bool run(const QString& baselines_path, bool update);
+
+private:
+    /**
+     * @brief Оператор с примером параметров
+     */
+    struct Case {
+        QString name;            ///< Имя оператора (S::name)
+        QString sql;             ///< Текст с параметрами $1..$n, как его подготавливает QPSQL
+        QStringList params;      ///< SQL-литералы значений параметров
+        QStringList full_scans;  ///< Таблицы, которые оператор читает целиком по замыслу
+        QString setup;           ///< Подготовка в той же транзакции перед EXPLAIN (может быть пустой)
+    };
+
+    /**
+     * @brief Результат EXPLAIN одного оператора
+     */
+    struct Plan {
+        double total_cost = 0;       ///< Оценка стоимости плана
+        double execution_ms = 0;     ///< Фактическое время выполнения
+        qint64 shared_hit = 0;       ///< Блоков прочитано из буферного кеша
+        qint64 shared_read = 0;      ///< Блоков прочитано с диска
+        QStringList seq_scans;       ///< Таблицы, прочитанные последовательным сканированием
+    };
+
+    /**
+     * @brief Значения из базы, на которых выполняются операторы
+     */
+    struct Sample {
+        int book_id = -1;
+        int author_id = -1;
+        int category_id = -1;
+        QString title;
+        QString author;
+        QString category;
+        int user_id = -1;
+        QString card_number;
+        int loan_id = -1;
+        int loan_book_id = -1;
+        int loan_user_id = -1;
+        QDate reference_day;        ///< Последний день выдач в наборе (дата расчетов)
+        qint64 catalog_clock_ms = 0; ///< Последнее изменение каталога (мс с эпохи Unix)
+    };
+
+    /**
+     * @brief Добавляет оператор S с параметрами
+     * @param full_scans Таблицы, которые S читает целиком по замыслу
+     * @param args Значения параметров в порядке S::params
+     */
+    template <typename S, typename... Args>
+    void add(const QStringList& full_scans, const Args&... args)
+    {
+        static_assert(sql::detail::all_bindable<typename S::params, Args...>(),
+                      "параметры примера не совпадают с S::params");
+        QString text = QString::fromUtf8(S::text);
+        int from = 0;
+        for (std::size_t i = 1; i <= S::params::size; ++i) {
+            const QString placeholder = QString("$%1").arg(i);
+            from = text.indexOf(QLatin1Char('?'), from);
+            text.replace(from, 1, placeholder);
+            from += placeholder.size();
+        }
+        cases_.push_back({QString::fromLatin1(S::name), text, QStringList{literal(args)...},
+                          full_scans, QString()});
+    }
+
+    /// @name SQL-литералы параметров
+    /// @{
+    static QString literal(const QString& value);
+    static QString literal(int value);
+    static QString literal(qint64 value);
+    static QString literal(double value);
+    static QString literal(const QDate& value);
+    /// @}
+
+    bool load_sample(Sample* sample);
+    void build_cases(const Sample& sample);
+    bool explain(const Case& item, bool generic, Plan* plan);
+    void check(const QString& name, const Case& item, const Plan& plan,
+               const QMap<QString, double>& baselines, bool update, bool* passed);
+    void collect_seq_scans(const QJsonObject& node, QStringList* tables) const;
+    bool load_table_sizes();
+    static bool read_baselines(const QString& path, QMap<QString, double>* baselines);
+    bool write_baselines(const QString& path, const QMap<QString, double>& baselines);
+
+    QSqlDatabase db_;                  ///< Подключение к базе данных
+    QTextStream& out_;                 ///< Поток для отчета
+    std::vector<Case> cases_;          ///< Проверяемые операторы
+    QMap<QString, double> table_rows_; ///< Оценка числа строк таблиц
+};
+
+#endif // PLANCHECK_H
@@ -0,0 +1,171 @@
+#include "reconcile.h"
+#include "statements.h"
+#include "logger.h"
+#include "tracer.h"
+#include <QElapsedTimer>
+#include <QSqlError>
+#include <QStringList>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Конструктор
+ * @param db Исходное подключение
+ * @param config Параметры сверки
+ */
+InventoryReconciler::InventoryReconciler(const QSqlDatabase &db, const Config &config)
+    : db_(db), config_(config)
+{
+}
+
+/**
+ * @brief Выполняет сверку
+ * @param report Итоги
+ * @return true если все диапазоны проверены без ошибок
+ * @note Потоки берут диапазоны из общего счетчика, поэтому медленный
+ * диапазон (например, с популярными книгами) не задерживает остальные
+ */
+bool InventoryReconciler::run(Report *report)
+{
+    TRACE_SPAN("InventoryReconciler::run");
+    QElapsedTimer timer;
+    timer.start();
+
+    auto range = sql::cache_for(db_).exec<stmt::BookIdRange>();
+    if (!range.next()) {
+        LOG_ERROR("reconcile").sql(range.error()).message("ошибка чтения диапазона книг");
+        return false;
+    }
+    const int minId = range.row().min_id;
+    const int maxId = range.row().max_id;
+    const int chunkSize = std::max(1, config_.chunk_size);
+    const int chunks = maxId >= minId ? (maxId - minId) / chunkSize + 1 : 0;
+
+    std::atomic<int> nextChunk{0};
+    std::atomic<int> failedChunks{0};
+    std::mutex resultMutex;
+    std::vector<Discrepancy> found;
+
+    auto worker = [&](int index) {
+        const QString connection = QString("reconcile_%1").arg(index);
+        {
+            QSqlDatabase db = QSqlDatabase::cloneDatabase(db_.connectionName(), connection);
+            if (db.open()) {
+                for (int chunk = nextChunk++; chunk < chunks; chunk = nextChunk++) {
+                    const int from = minId + chunk * chunkSize;
+                    std::vector<Discrepancy> local;
+                    if (!reconcile_chunk(db, from, from + chunkSize, &local)) {
+                        ++failedChunks;
+                    }
+                    // Расхождения, найденные до ошибки исправления, тоже попадают в отчет
+                    std::lock_guard<std::mutex> lock(resultMutex);
+                    found.insert(found.end(), local.begin(), local.end());
+                }
+                sql::cache_for(db).clear();
+                db.close();
+            } else {
+                // Диапазоны достанутся другим потокам
+                LOG_ERROR("reconcile").sql(db.lastError()).message("ошибка подключения потока сверки");
+            }
+        }
+        QSqlDatabase::removeDatabase(connection);
+    };
+
+    const int threads = std::max(1, std::min(config_.threads, chunks));
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; ++i) {
+        pool.emplace_back(worker, i);
+    }
+    for (std::thread &thread : pool) {
+        thread.join();
+    }
+
+    // Диапазоны, не взятые ни одним потоком (все подключения не открылись)
+    const int unprocessed = std::max(0, chunks - std::min(int(nextChunk), chunks));
+    std::sort(found.begin(), found.end(),
+              [](const Discrepancy &a, const Discrepancy &b) { return a.book_id < b.book_id; });
+
+    report->discrepancies = std::move(found);
+    report->chunks = chunks;
+    report->failed_chunks = failedChunks + unprocessed;
+    report->elapsed_ms = timer.elapsed();
+    LOG_INFO("reconcile").latency(timer);
+    return report->failed_chunks == 0;
+}
+
+/**
+ * @brief Проверяет и при необходимости исправляет диапазон
+ * @param db Подключение потока
+ * @param from Первый ID диапазона
+ * @param to ID за концом диапазона
+ * @param found Найденные расхождения
+ * @return true при успехе
+ * @note Проверка выполняется вне явной транзакции и не берет блокировок;
+ * транзакция исправления затрагивает только найденные книги
+ */
+bool InventoryReconciler::reconcile_chunk(const QSqlDatabase &db, int from, int to, std::vector<Discrepancy> *found)
+{
+    TRACE_SPAN("reconcile_chunk");
+    sql::StatementCache &statements = sql::cache_for(db);
+
+    auto drift = statements.exec<stmt::FindAvailabilityDrift>(from, to, from, to);
+    if (!drift.ok()) {
+        LOG_ERROR("reconcile").sql(drift.error()).message("ошибка проверки диапазона");
+        return false;
+    }
+    QStringList ids;
+    while (drift.next()) {
+        const auto row = drift.row();
+        found->push_back({row.book_id, row.availability_count, row.expected, false});
+        ids << QString::number(row.book_id);
+    }
+    if (!config_.repair || ids.isEmpty()) {
+        return true;
+    }
+
+    QSqlDatabase connection = db;
+    if (!connection.transaction()) {
+        LOG_ERROR("reconcile").sql(connection.lastError()).message("ошибка начала транзакции");
+        return false;
+    }
+    const QString array = "{" + ids.join(',') + "}";
+    auto timeout = statements.exec<stmt::SetLockTimeout>(QString("%1ms").arg(config_.lock_timeout_ms));
+    auto lock = statements.exec<stmt::LockBooks>(array);
+    if (!timeout.ok() || !lock.ok()) {
+        LOG_WARNING("reconcile").sql(timeout.ok() ? lock.error() : timeout.error())
+            .message("книги заняты, диапазон будет исправлен при следующем запуске");
+        connection.rollback();
+        return false;
+    }
+
+    // Пересчет под блокировкой: учитываются выдачи, зафиксированные после проверки
+    auto repair = statements.exec<stmt::RepairAvailability>(array);
+    if (!repair.ok()) {
+        LOG_ERROR("reconcile").sql(repair.error()).message("ошибка исправления счетчиков");
+        connection.rollback();
+        return false;
+    }
+    std::vector<Discrepancy> repaired;
+    while (repair.next()) {
+        const auto row = repair.row();
+        repaired.push_back({row.book_id, 0, row.availability_count, true});
+    }
+    if (!connection.commit()) {
+        LOG_ERROR("reconcile").sql(connection.lastError()).message("ошибка фиксации транзакции");
+        connection.rollback();
+        return false;
+    }
+
+    for (Discrepancy &item : *found) {
+        for (const Discrepancy &fixed : repaired) {
+            if (fixed.book_id == item.book_id) {
+                item.expected = fixed.expected;
+                item.repaired = true;
+                LOG_INFO("reconcile").book(item.book_id).message("счетчик доступных экземпляров исправлен");
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef RECONCILE_H
+#define RECONCILE_H
+
+#include <QSqlDatabase>
+#include <vector>
+
+/**
+ * @brief Сверка счетчиков доступных экземпляров с выдачами
+ *
+ * Ожидаемое значение availability_count книги — total_copies минус
+ * открытые выдачи в book_loans. Для книг, существовавших до миграции,
+ * total_copies выведено из тогдашнего счетчика (см. Schema), поэтому
+ * расхождение, накопленное до миграции, сверка не находит (кроме
+ * отрицательных счетчиков): для этого нужно реальное число экземпляров,
+ * например по инвентаризации. Каталог делится на диапазоны book_id,
+ * которые параллельно проверяются одним запросом на диапазон
+ * (stmt::FindAvailabilityDrift) по отдельным подключениям.
+ *
+ * Проверка только читает данные и не блокирует выдачу. При исправлении
+ * для каждого диапазона открывается короткая транзакция: блокируются
+ * лишь расходящиеся книги (с ограничением ожидания), счетчик
+ * пересчитывается заново под блокировкой и записывается, только если
+ * все еще расходится. Выдача или возврат, ожидающие этой блокировки,
+ * после нее применяют свое изменение к уже исправленному значению.
+ */
+class InventoryReconciler {
+public:
+    /**
+     * @brief Параметры сверки
+     */
+    struct Config {
+        int chunk_size = 10000;        ///< Книг в одном диапазоне
+        int threads = 4;               ///< Параллельных подключений
+        bool repair = false;           ///< Исправлять расхождения, а не только сообщать
+        int lock_timeout_ms = 2000;    ///< Предельное ожидание блокировки книг при исправлении
+    };
+
+    /**
+     * @brief Расхождение по одной книге
+     */
+    struct Discrepancy {
+        int book_id = 0;        ///< ID книги
+        int recorded = 0;       ///< Значение availability_count при проверке
+        int expected = 0;       ///< total_copies минус открытые выдачи
+        bool repaired = false;  ///< Счетчик исправлен
+    };
+
+    /**
+     * @brief Итоги сверки
+     */
+    struct Report {
+        std::vector<Discrepancy> discrepancies;  ///< Найденные расхождения по возрастанию book_id
+        int chunks = 0;                          ///< Проверено диапазонов
+        int failed_chunks = 0;                   ///< Диапазонов с ошибкой (в т.ч. по ожиданию блокировки)
+        qint64 elapsed_ms = 0;                   ///< Длительность сверки
+    };
+
+    /**
+     * @brief Конструктор
+     * @param db Подключение, параметры которого копируются для потоков
+     * @param config Параметры сверки
+     */
+    InventoryReconciler(const QSqlDatabase& db, const Config& config);
+
+    /**
+     * @brief Выполняет сверку
+     * @param report Итоги (не может быть nullptr)
+     * @return true если все диапазоны проверены без ошибок
+     */
+    bool run(Report* report);
+
+private:
+    /**
+     * @brief Проверяет и при необходимости исправляет диапазон [from, to)
+     * @param db Подключение потока
+     * @param from Первый ID диапазона
+     * @param to ID за концом диапазона
+     * @param found Найденные расхождения
+     * @return true при успехе
+     */
+    bool reconcile_chunk(const QSqlDatabase& db, int from, int to, std::vector<Discrepancy>* found);
+
+    QSqlDatabase db_;  ///< Исходное подключение
+    Config config_;    ///< Параметры сверки
+};
+
+#endif // RECONCILE_H
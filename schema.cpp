@@ -0,0 +1,243 @@
+#include "schema.h"
+#include "logger.h"
+#include <QSqlQuery>
+#include <QSqlError>
+
+namespace {
+
+/**
+ * @brief DDL-операторы в порядке применения
+ */
+const char *const kMigrations[] = {
+    // Открытые выдачи: частичный индекс, по которому работают
+    // ночной расчет просрочек и поиск выдачи при возврате
+    "CREATE INDEX IF NOT EXISTS book_loans_open_idx ON book_loans (loan_date, book_id) "
+    "WHERE return_date IS NULL",
+
+    // Срок выдачи и пеня за день просрочки по категориям.
+    // Для категорий без записи действует политика по умолчанию (OverdueEngine)
+    "CREATE TABLE IF NOT EXISTS loan_policies ("
+    " category_id integer PRIMARY KEY REFERENCES categories (category_id) ON DELETE CASCADE,"
+    " loan_days integer NOT NULL CHECK (loan_days > 0),"
+    " daily_fine numeric(10, 2) NOT NULL CHECK (daily_fine >= 0))",
+
+    // Результат ночного расчета: просроченные выдачи
+    "CREATE TABLE IF NOT EXISTS overdue_loans ("
+    " loan_id integer PRIMARY KEY,"
+    " user_id integer NOT NULL,"
+    " book_id integer NOT NULL,"
+    " due_date date NOT NULL,"
+    " days_overdue integer NOT NULL,"
+    " fine numeric(10, 2) NOT NULL,"
+    " computed_on date NOT NULL)",
+    "CREATE INDEX IF NOT EXISTS overdue_loans_days_idx ON overdue_loans (days_overdue DESC)",
+
+    // Сводка по читателям для предупреждения на кафедре выдачи
+    "CREATE TABLE IF NOT EXISTS overdue_readers ("
+    " user_id integer PRIMARY KEY,"
+    " overdue_count integer NOT NULL,"
+    " max_days_overdue integer NOT NULL,"
+    " total_fine numeric(12, 2) NOT NULL,"
+    " computed_on date NOT NULL)",
+
+    // Статистика выдач по книгам и дням. Категория хранится на момент выдачи,
+    // первичный ключ (day, book_id) служит и индексом по диапазону дат
+    "CREATE TABLE IF NOT EXISTS circulation_daily ("
+    " day date NOT NULL,"
+    " book_id integer NOT NULL,"
+    " category_id integer,"
+    " issues integer NOT NULL DEFAULT 0,"
+    " returns integer NOT NULL DEFAULT 0,"
+    " PRIMARY KEY (day, book_id))",
+
+    // Текущие выдачи по читателям
+    "CREATE TABLE IF NOT EXISTS reader_loans ("
+    " user_id integer PRIMARY KEY,"
+    " current_loans integer NOT NULL DEFAULT 0,"
+    " total_loans integer NOT NULL DEFAULT 0,"
+    " last_loan_date date)",
+    "CREATE INDEX IF NOT EXISTS reader_loans_active_idx ON reader_loans (current_loans DESC) "
+    "WHERE current_loans > 0",
+
+    // Триггер поддерживает статистику в той же транзакции, что и выдача/возврат.
+    // Удаление выдачи (в том числе каскадное, вместе с книгой или читателем)
+    // уменьшает только число текущих выдач: история выдач и возвратов остается
+    "CREATE OR REPLACE FUNCTION circulation_stats_on_loan() RETURNS trigger "
+    "LANGUAGE plpgsql AS $$ "
+    "BEGIN "
+    "  IF TG_OP = 'INSERT' THEN "
+    "    INSERT INTO circulation_daily (day, book_id, category_id, issues) "
+    "    SELECT NEW.loan_date, NEW.book_id, b.category_id, 1 FROM books b WHERE b.book_id = NEW.book_id "
+    "    ON CONFLICT (day, book_id) DO UPDATE SET issues = circulation_daily.issues + 1; "
+    "    INSERT INTO reader_loans (user_id, current_loans, total_loans, last_loan_date) "
+    "    VALUES (NEW.user_id, CASE WHEN NEW.return_date IS NULL THEN 1 ELSE 0 END, 1, NEW.loan_date) "
+    "    ON CONFLICT (user_id) DO UPDATE SET "
+    "      current_loans = reader_loans.current_loans + EXCLUDED.current_loans, "
+    "      total_loans = reader_loans.total_loans + 1, "
+    "      last_loan_date = GREATEST(reader_loans.last_loan_date, EXCLUDED.last_loan_date); "
+    "  ELSIF TG_OP = 'DELETE' THEN "
+    "    IF OLD.return_date IS NULL THEN "
+    "      UPDATE reader_loans SET current_loans = current_loans - 1 WHERE user_id = OLD.user_id; "
+    "    END IF; "
+    "  ELSIF OLD.return_date IS NOT DISTINCT FROM NEW.return_date THEN "
+    "    RETURN NULL; "
+    "  ELSE "
+    "    IF OLD.return_date IS NOT NULL THEN "
+    "      UPDATE circulation_daily SET returns = returns - 1 "
+    "      WHERE day = OLD.return_date AND book_id = OLD.book_id; "
+    "    END IF; "
+    "    IF NEW.return_date IS NOT NULL THEN "
+    "      INSERT INTO circulation_daily (day, book_id, category_id, returns) "
+    "      SELECT NEW.return_date, NEW.book_id, b.category_id, 1 FROM books b WHERE b.book_id = NEW.book_id "
+    "      ON CONFLICT (day, book_id) DO UPDATE SET returns = circulation_daily.returns + 1; "
+    "    END IF; "
+    "    IF OLD.return_date IS NULL THEN "
+    "      UPDATE reader_loans SET current_loans = current_loans - 1 WHERE user_id = NEW.user_id; "
+    "    ELSIF NEW.return_date IS NULL THEN "
+    "      UPDATE reader_loans SET current_loans = current_loans + 1 WHERE user_id = NEW.user_id; "
+    "    END IF; "
+    "  END IF; "
+    "  RETURN NULL; "
+    "END $$",
+    "DROP TRIGGER IF EXISTS book_loans_circulation_stats ON book_loans",
+    "CREATE TRIGGER book_loans_circulation_stats "
+    "AFTER INSERT OR UPDATE OF return_date OR DELETE ON book_loans "
+    "FOR EACH ROW EXECUTE FUNCTION circulation_stats_on_loan()",
+
+    // Первичное заполнение статистики по истории выдач (только для пустых таблиц).
+    // Выполняется в транзакции миграции после создания триггера, поэтому
+    // выдачи, зафиксированные после миграции, не теряются и не учитываются дважды
+    "INSERT INTO circulation_daily (day, book_id, category_id, issues, returns) "
+    "SELECT e.day, e.book_id, b.category_id, SUM(e.issues), SUM(e.returns) FROM ("
+    "  SELECT loan_date AS day, book_id, 1 AS issues, 0 AS returns FROM book_loans "
+    "  UNION ALL "
+    "  SELECT return_date, book_id, 0, 1 FROM book_loans WHERE return_date IS NOT NULL) e "
+    "JOIN books b ON b.book_id = e.book_id "
+    "WHERE NOT EXISTS (SELECT 1 FROM circulation_daily) "
+    "GROUP BY e.day, e.book_id, b.category_id",
+    "INSERT INTO reader_loans (user_id, current_loans, total_loans, last_loan_date) "
+    "SELECT user_id, COUNT(*) FILTER (WHERE return_date IS NULL), COUNT(*), MAX(loan_date) "
+    "FROM book_loans WHERE NOT EXISTS (SELECT 1 FROM reader_loans) "
+    "GROUP BY user_id",
+    // Исправление числа текущих выдач, завышенного удалениями выдач до того,
+    // как триггер стал их учитывать
+    "UPDATE reader_loans r SET current_loans = COALESCE(o.open_loans, 0) "
+    "FROM reader_loans r2 LEFT JOIN ("
+    "  SELECT user_id, COUNT(*) AS open_loans FROM book_loans WHERE return_date IS NULL "
+    "  GROUP BY user_id) o ON o.user_id = r2.user_id "
+    "WHERE r.user_id = r2.user_id AND r.current_loans <> COALESCE(o.open_loans, 0)",
+
+    // Индексы поиска на кафедре выдачи: книга по названию, автор по
+    // полному имени (в том виде, в котором его сравнивают запросы), читатель
+    // по номеру билета и открытая выдача по читателю
+    "CREATE INDEX IF NOT EXISTS books_title_idx ON books (title)",
+    "CREATE INDEX IF NOT EXISTS authors_full_name_idx ON authors ((first_name || ' ' || last_name))",
+    "CREATE INDEX IF NOT EXISTS users_card_number_idx ON users (library_card_number)",
+    "CREATE INDEX IF NOT EXISTS book_loans_open_user_idx ON book_loans (user_id, book_id) "
+    "WHERE return_date IS NULL",
+
+    // Открытые выдачи по книге: сверка фонда считает их диапазонами book_id
+    "CREATE INDEX IF NOT EXISTS book_loans_open_book_idx ON book_loans (book_id) "
+    "WHERE return_date IS NULL",
+
+    // Всего экземпляров книги; доступно = total_copies - открытые выдачи.
+    // Настоящего числа экземпляров в базе нет, поэтому для уже существующих
+    // книг оно один раз выводится из счетчика: расхождение, накопленное до
+    // миграции, становится частью total_copies и сверкой не находится.
+    // Отрицательный счетчик заведомо неверен и считается нулем, поэтому
+    // такие книги сверка находит
+    "ALTER TABLE books ADD COLUMN IF NOT EXISTS total_copies integer",
+    "UPDATE books b SET total_copies = GREATEST(b.availability_count, 0) + "
+    "(SELECT COUNT(*) FROM book_loans l WHERE l.book_id = b.book_id AND l.return_date IS NULL) "
+    "WHERE b.total_copies IS NULL",
+    "ALTER TABLE books ALTER COLUMN total_copies SET NOT NULL",
+
+    // Дельта для кеша каталога на рабочих местах: время изменения строк
+    // книг и пользователей и журнал удалений (хранится 30 дней, см. CatalogCache).
+    // Переименование автора или категории отмечает измененными их книги
+    "ALTER TABLE books ADD COLUMN IF NOT EXISTS updated_at timestamptz NOT NULL DEFAULT now()",
+    "ALTER TABLE users ADD COLUMN IF NOT EXISTS updated_at timestamptz NOT NULL DEFAULT now()",
+    "CREATE INDEX IF NOT EXISTS books_updated_at_idx ON books (updated_at)",
+    "CREATE INDEX IF NOT EXISTS users_updated_at_idx ON users (updated_at)",
+    "CREATE OR REPLACE FUNCTION catalog_touch() RETURNS trigger "
+    "LANGUAGE plpgsql AS $$ "
+    "BEGIN "
+    "  NEW.updated_at := now(); "
+    "  RETURN NEW; "
+    "END $$",
+    "DROP TRIGGER IF EXISTS books_catalog_touch ON books",
+    "CREATE TRIGGER books_catalog_touch BEFORE UPDATE ON books "
+    "FOR EACH ROW EXECUTE FUNCTION catalog_touch()",
+    "DROP TRIGGER IF EXISTS users_catalog_touch ON users",
+    "CREATE TRIGGER users_catalog_touch BEFORE UPDATE ON users "
+    "FOR EACH ROW EXECUTE FUNCTION catalog_touch()",
+    // Аргумент триггера — колонка books, ссылающаяся на переименованную строку
+    // (совпадает с именем ключа в ее таблице)
+    "CREATE OR REPLACE FUNCTION catalog_touch_books() RETURNS trigger "
+    "LANGUAGE plpgsql AS $$ "
+    "BEGIN "
+    "  EXECUTE format('UPDATE books SET updated_at = now() WHERE %I = $1', TG_ARGV[0]) "
+    "  USING CAST(to_jsonb(NEW) ->> TG_ARGV[0] AS integer); "
+    "  RETURN NULL; "
+    "END $$",
+    "DROP TRIGGER IF EXISTS authors_catalog_touch ON authors",
+    "CREATE TRIGGER authors_catalog_touch AFTER UPDATE OF first_name, last_name ON authors "
+    "FOR EACH ROW WHEN (OLD.first_name IS DISTINCT FROM NEW.first_name "
+    "                   OR OLD.last_name IS DISTINCT FROM NEW.last_name) "
+    "EXECUTE FUNCTION catalog_touch_books('author_id')",
+    "DROP TRIGGER IF EXISTS categories_catalog_touch ON categories",
+    "CREATE TRIGGER categories_catalog_touch AFTER UPDATE OF name ON categories "
+    "FOR EACH ROW WHEN (OLD.name IS DISTINCT FROM NEW.name) "
+    "EXECUTE FUNCTION catalog_touch_books('category_id')",
+
+    "CREATE TABLE IF NOT EXISTS catalog_deletions ("
+    " table_name text NOT NULL,"
+    " row_id integer NOT NULL,"
+    " deleted_at timestamptz NOT NULL DEFAULT now())",
+    "CREATE INDEX IF NOT EXISTS catalog_deletions_at_idx ON catalog_deletions (deleted_at)",
+    // Аргумент триггера — имя ключевой колонки удаляемой строки
+    "CREATE OR REPLACE FUNCTION catalog_tombstone() RETURNS trigger "
+    "LANGUAGE plpgsql AS $$ "
+    "BEGIN "
+    "  INSERT INTO catalog_deletions (table_name, row_id) "
+    "  VALUES (TG_TABLE_NAME, CAST(to_jsonb(OLD) ->> TG_ARGV[0] AS integer)); "
+    "  DELETE FROM catalog_deletions WHERE deleted_at < now() - interval '30 days'; "
+    "  RETURN NULL; "
+    "END $$",
+    "DROP TRIGGER IF EXISTS books_catalog_tombstone ON books",
+    "CREATE TRIGGER books_catalog_tombstone AFTER DELETE ON books "
+    "FOR EACH ROW EXECUTE FUNCTION catalog_tombstone('book_id')",
+    "DROP TRIGGER IF EXISTS users_catalog_tombstone ON users",
+    "CREATE TRIGGER users_catalog_tombstone AFTER DELETE ON users "
+    "FOR EACH ROW EXECUTE FUNCTION catalog_tombstone('user_id')",
+};
+
+} // namespace
+
+/**
+ * @brief Применяет миграции
+ * @param db Открытое подключение к базе данных
+ * @return true при успехе, false при ошибке (транзакция откатывается)
+ */
+bool Schema::migrate(QSqlDatabase db)
+{
+    if (!db.transaction()) {
+        LOG_ERROR("migrate").sql(db.lastError()).message("ошибка начала транзакции");
+        return false;
+    }
+
+    QSqlQuery query(db);
+    for (const char *statement : kMigrations) {
+        if (!query.exec(QString::fromUtf8(statement))) {
+            LOG_ERROR("migrate").sql(query.lastError()).message("ошибка миграции");
+            db.rollback();
+            return false;
+        }
+    }
+
+    if (!db.commit()) {
+        LOG_ERROR("migrate").sql(db.lastError()).message("ошибка фиксации транзакции");
+        return false;
+    }
+    return true;
+}
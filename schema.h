@@ -0,0 +1,24 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <QSqlDatabase>
+
+/**
+ * @brief Миграции служебных таблиц и индексов библиотечной БД
+ *
+ * Все операторы идемпотентны (IF NOT EXISTS / OR REPLACE), поэтому
+ * миграцию можно запускать повторно. Запускается из консольного режима
+ * командой `migrate`, а не при каждом старте рабочего места: DDL берет
+ * блокировки на таблицы, с которыми работают кафедры выдачи.
+ */
+class Schema {
+public:
+    /**
+     * @brief Применяет все миграции в одной транзакции
+     * @param db Открытое подключение к базе данных
+     * @return true если все операторы выполнены успешно
+     */
+    static bool migrate(QSqlDatabase db);
+};
+
+#endif // SCHEMA_H
@@ -0,0 +1,366 @@
+#ifndef SQLREGISTRY_H
+#define SQLREGISTRY_H
+
+#include <QString>
+#include <QVariant>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include "tracer.h"
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Типизированный реестр SQL-операторов
+ *
+ * Каждый оператор описывается структурой, производной от sql::Statement,
+ * с текстом запроса (позиционные параметры `?`), типами параметров и
+ * типами колонок результата:
+ * @code
+ * struct FindUserByCard : sql::Statement<sql::Params<QString>, sql::Columns<int>> {
+ *     static constexpr char name[] = "find_user_by_card";
+ *     static constexpr char text[] = "SELECT user_id FROM users WHERE library_card_number = ?";
+ *     struct Row { int user_id; };
+ * };
+ *
+ * auto result = sql::cache_for(db).exec<FindUserByCard>(card_number);
+ * if (result.ok() && result.next()) {
+ *     int userId = result.row().user_id;
+ * }
+ * @endcode
+ * Неверное количество или тип аргументов — ошибка компиляции.
+ * Операторы подготавливаются один раз на подключение (StatementCache)
+ * и связываются по номеру параметра, без поиска по имени.
+ * Каждое выполнение отмечается интервалом трассировки с именем S::name.
+ */
+namespace sql {
+
+/**
+ * @brief Список типов параметров оператора
+ */
+template <typename... Ts>
+struct Params {
+    using tuple = std::tuple<Ts...>;
+    static constexpr std::size_t size = sizeof...(Ts);
+};
+
+/**
+ * @brief Список типов колонок результата оператора
+ */
+template <typename... Ts>
+struct Columns {
+    using tuple = std::tuple<Ts...>;
+    static constexpr std::size_t size = sizeof...(Ts);
+};
+
+/**
+ * @brief Базовый класс описания оператора
+ * @tparam P Типы параметров (sql::Params)
+ * @tparam C Типы колонок результата (sql::Columns, пустой для команд)
+ *
+ * Производная структура задает name, text и, если есть результат,
+ * агрегат Row с полями в порядке колонок.
+ */
+template <typename P, typename C = Columns<>>
+struct Statement {
+    using params = P;
+    using columns = C;
+    struct Row {};
+};
+
+/**
+ * @brief Преобразование значения C++ в QVariant и обратно
+ */
+template <typename T>
+struct Value {
+    static QVariant to(const T& value) { return QVariant::fromValue(value); }
+    static T from(const QVariant& value) { return value.value<T>(); }
+};
+
+/**
+ * @brief Колонка, допускающая NULL
+ */
+template <typename T>
+struct Value<std::optional<T>> {
+    static std::optional<T> from(const QVariant& value)
+    {
+        if (value.isNull()) {
+            return std::nullopt;
+        }
+        return value.value<T>();
+    }
+};
+
+namespace detail {
+
+/**
+ * @brief Можно ли передать аргумент типа A в параметр типа P
+ *
+ * Числовые параметры требуют точного совпадения типа (без неявных
+ * сужений и bool → int), остальные — неявного преобразования
+ * (например, строковый литерал в QString).
+ */
+template <typename P, typename A>
+constexpr bool bindable = std::is_arithmetic_v<P>
+    ? std::is_same_v<std::decay_t<A>, P>
+    : std::is_convertible_v<A, P>;
+
+template <typename P, typename... Args, std::size_t... I>
+constexpr bool all_bindable_at(std::index_sequence<I...>)
+{
+    return (bindable<std::tuple_element_t<I, typename P::tuple>, Args> && ...);
+}
+
+template <typename P, typename... Args>
+constexpr bool all_bindable()
+{
+    if constexpr (sizeof...(Args) != P::size) {
+        return false;
+    } else {
+        return all_bindable_at<P, Args...>(std::make_index_sequence<P::size>());
+    }
+}
+
+/**
+ * @brief Следующий свободный номер оператора
+ */
+inline std::size_t next_slot()
+{
+    static std::atomic<std::size_t> counter{0};
+    return counter++;
+}
+
+/**
+ * @brief Номер оператора S в кеше; вычисляется один раз на тип
+ */
+template <typename S>
+std::size_t slot()
+{
+    static const std::size_t id = next_slot();
+    return id;
+}
+
+/**
+ * @brief Подготовленный запрос в кеше и номер его последнего выполнения
+ */
+struct Prepared {
+    explicit Prepared(const QSqlDatabase& db) : query(db) {}
+
+    QSqlQuery query;          ///< Подготовленный запрос
+    quint64 generation = 0;   ///< Увеличивается при каждом выполнении
+};
+
+} // namespace detail
+
+/**
+ * @brief Результат выполнения оператора S
+ *
+ * Ссылается на подготовленный запрос из StatementCache и действителен
+ * до следующего выполнения того же оператора на том же подключении или
+ * до StatementCache::clear(). Устаревший результат не обращается к
+ * запросу: next() возвращает false, row() — пустую строку,
+ * rows_affected() — -1, а stale() — true.
+ */
+template <typename S>
+class Result {
+public:
+    using Row = typename S::Row;
+
+    Result(const std::shared_ptr<detail::Prepared>& prepared, bool ok, const QSqlError& error)
+        : prepared_(prepared),
+          generation_(prepared ? prepared->generation : 0),
+          ok_(ok),
+          error_(error)
+    {
+    }
+
+    /// @brief true если оператор выполнен без ошибок
+    bool ok() const { return ok_; }
+
+    /// @brief Ошибка подготовки или выполнения
+    const QSqlError& error() const { return error_; }
+
+    /// @brief true если запрос освобожден или выполнен заново после этого результата
+    bool stale() const { return !live(); }
+
+    /// @brief Переходит к следующей строке результата
+    bool next()
+    {
+        const std::shared_ptr<detail::Prepared> prepared = live();
+        return ok_ && prepared && prepared->query.next();
+    }
+
+    /// @brief Количество строк, измененных командой
+    int rows_affected() const
+    {
+        const std::shared_ptr<detail::Prepared> prepared = live();
+        return ok_ && prepared ? prepared->query.numRowsAffected() : -1;
+    }
+
+    /**
+     * @brief Текущая строка результата в виде структуры S::Row
+     */
+    Row row() const
+    {
+        const std::shared_ptr<detail::Prepared> prepared = live();
+        if (!ok_ || !prepared) {
+            return Row{};
+        }
+        return read(prepared->query, std::make_index_sequence<S::columns::size>());
+    }
+
+private:
+    /// @brief Запрос, если он еще относится к этому результату
+    std::shared_ptr<detail::Prepared> live() const
+    {
+        std::shared_ptr<detail::Prepared> prepared = prepared_.lock();
+        return prepared && prepared->generation == generation_ ? prepared : nullptr;
+    }
+
+    template <std::size_t... I>
+    static Row read(const QSqlQuery& query, std::index_sequence<I...>)
+    {
+        using Tuple = typename S::columns::tuple;
+        return Row{Value<std::tuple_element_t<I, Tuple>>::from(query.value(int(I)))...};
+    }
+
+    std::weak_ptr<detail::Prepared> prepared_;  ///< Запрос из кеша (не продлевает его жизнь)
+    quint64 generation_;                        ///< Номер выполнения, к которому относится результат
+    bool ok_;                                   ///< Признак успешного выполнения
+    QSqlError error_;                           ///< Ошибка подготовки или выполнения
+};
+
+/**
+ * @brief Кеш подготовленных операторов одного подключения
+ *
+ * Каждый оператор подготавливается при первом выполнении и далее
+ * переиспользуется; номер оператора в кеше вычисляется на этапе
+ * инициализации типа, поиск строк не выполняется.
+ */
+class StatementCache {
+public:
+    /**
+     * @brief Конструктор
+     * @param connection Имя подключения QSqlDatabase
+     */
+    explicit StatementCache(const QString& connection)
+        : connection_(connection)
+    {
+    }
+
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+
+    /**
+     * @brief Выполняет оператор S с позиционными параметрами
+     * @param args Значения параметров в порядке S::params
+     * @return Результат выполнения
+     */
+    template <typename S, typename... Args>
+    Result<S> exec(Args&&... args)
+    {
+        using P = typename S::params;
+        static_assert(sizeof...(Args) == P::size,
+                      "неверное количество параметров SQL-оператора");
+        static_assert(detail::all_bindable<P, Args...>(),
+                      "неверный тип параметра SQL-оператора");
+        TRACE_SPAN(S::name, "sql");
+
+        const std::shared_ptr<detail::Prepared>& prepared = prepare<S>();
+        if (!prepared) {
+            return Result<S>(nullptr, false, prepare_error_);
+        }
+        QSqlQuery& query = prepared->query;
+        ++prepared->generation;
+        bind<P>(query, std::make_index_sequence<P::size>(), std::forward<Args>(args)...);
+        const bool ok = query.exec();
+        return Result<S>(prepared, ok, ok ? QSqlError() : query.lastError());
+    }
+
+    /**
+     * @brief Освобождает подготовленные операторы
+     * @note Вызывается при переподключении и перед закрытием подключения;
+     * полученные ранее результаты становятся устаревшими (Result::stale)
+     */
+    void clear() { queries_.clear(); }
+
+    /**
+     * @brief Подключение, к которому относится кеш
+     */
+    QSqlDatabase database() const { return QSqlDatabase::database(connection_, false); }
+
+private:
+    template <typename S>
+    const std::shared_ptr<detail::Prepared>& prepare()
+    {
+        const std::size_t id = detail::slot<S>();
+        if (id >= queries_.size()) {
+            queries_.resize(id + 1);
+        }
+        std::shared_ptr<detail::Prepared>& prepared = queries_[id];
+        if (!prepared) {
+            prepared = std::make_shared<detail::Prepared>(database());
+            prepared->query.setForwardOnly(true);
+            if (!prepared->query.prepare(QString::fromUtf8(S::text))) {
+                prepare_error_ = prepared->query.lastError();
+                prepared.reset();
+            }
+        }
+        return prepared;
+    }
+
+    template <typename P, std::size_t... I, typename... Args>
+    static void bind(QSqlQuery& query, std::index_sequence<I...>, Args&&... args)
+    {
+        using Tuple = typename P::tuple;
+        (query.bindValue(int(I), Value<std::tuple_element_t<I, Tuple>>::to(
+             std::tuple_element_t<I, Tuple>(std::forward<Args>(args)))), ...);
+    }
+
+    QString connection_;                                      ///< Имя подключения
+    std::vector<std::shared_ptr<detail::Prepared>> queries_;  ///< Подготовленные операторы по номеру
+    QSqlError prepare_error_;                                 ///< Последняя ошибка подготовки
+};
+
+/**
+ * @brief Кеш операторов для подключения с заданным именем
+ *
+ * Кеши хранятся отдельно для каждого потока, так как подключение
+ * QSqlDatabase можно использовать только из создавшего его потока.
+ */
+inline StatementCache& cache_for(const QString& connection)
+{
+    thread_local std::map<QString, std::unique_ptr<StatementCache>> caches;
+    std::unique_ptr<StatementCache>& cache = caches[connection];
+    if (!cache) {
+        cache = std::make_unique<StatementCache>(connection);
+    }
+    return *cache;
+}
+
+/**
+ * @brief Кеш операторов для подключения
+ */
+inline StatementCache& cache_for(const QSqlDatabase& db)
+{
+    return cache_for(db.connectionName());
+}
+
+/**
+ * @brief Кеш операторов подключения по умолчанию
+ */
+inline StatementCache& default_cache()
+{
+    return cache_for(QString::fromLatin1(QSqlDatabase::defaultConnection));
+}
+
+} // namespace sql
+
+#endif // SQLREGISTRY_H
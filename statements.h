@@ -0,0 +1,536 @@
+#ifndef STATEMENTS_H
+#define STATEMENTS_H
+
+#include <QDate>
+#include <QString>
+#include <optional>
+#include "sqlregistry.h"
+
+/**
+ * @brief SQL-операторы приложения
+ *
+ * Все запросы к данным описаны здесь, с типами параметров и колонок.
+ * Миграции схемы (DDL) находятся в schema.cpp.
+ */
+namespace stmt {
+
+/// @name Книги и авторы
+/// @{
+/**
+ * @brief Поиск книги по названию и автору ("Имя Фамилия")
+ */
+struct FindBook : sql::Statement<sql::Params<QString, QString>, sql::Columns<int, int>> {
+    static constexpr char name[] = "find_book";
+    static constexpr char text[] =
+        "SELECT book_id, availability_count FROM books WHERE title = ? AND author_id = "
+        "(SELECT author_id FROM authors WHERE first_name || ' ' || last_name = ?)";
+    struct Row {
+        int book_id;
+        int availability_count;
+    };
+};
+
+/**
+ * @brief Изменение счетчика доступных экземпляров на delta
+ */
+struct AdjustAvailability : sql::Statement<sql::Params<int, int>> {
+    static constexpr char name[] = "adjust_availability";
+    static constexpr char text[] =
+        "UPDATE books SET availability_count = availability_count + ? WHERE book_id = ?";
+};
+
+/**
+ * @brief Поиск автора по имени ("Имя Фамилия")
+ */
+struct FindAuthor : sql::Statement<sql::Params<QString>, sql::Columns<int>> {
+    static constexpr char name[] = "find_author";
+    static constexpr char text[] =
+        "SELECT author_id FROM authors WHERE first_name || ' ' || last_name = ?";
+    struct Row {
+        int author_id;
+    };
+};
+
+/**
+ * @brief Поиск категории по названию
+ */
+struct FindCategory : sql::Statement<sql::Params<QString>, sql::Columns<int>> {
+    static constexpr char name[] = "find_category";
+    static constexpr char text[] = "SELECT category_id FROM categories WHERE name = ?";
+    struct Row {
+        int category_id;
+    };
+};
+
+/**
+ * @brief Добавление книги: название, автор, категория, количество
+ *
+ * У новой книги нет выдач, поэтому количество задает и доступные,
+ * и все экземпляры (total_copies).
+ */
+struct InsertBook : sql::Statement<sql::Params<QString, int, int, int>> {
+    static constexpr char name[] = "insert_book";
+    static constexpr char text[] =
+        "INSERT INTO books (title, author_id, category_id, availability_count, total_copies) "
+        "SELECT v.title, v.author_id, v.category_id, v.copies, v.copies FROM (VALUES ("
+        "CAST(? AS text), CAST(? AS integer), CAST(? AS integer), CAST(? AS integer))) "
+        "v (title, author_id, category_id, copies)";
+};
+
+/**
+ * @brief Удаление книги по названию и автору ("Имя Фамилия")
+ */
+struct DeleteBook : sql::Statement<sql::Params<QString, QString>> {
+    static constexpr char name[] = "delete_book";
+    static constexpr char text[] =
+        "DELETE FROM books WHERE title = ? AND author_id = "
+        "(SELECT author_id FROM authors WHERE first_name || ' ' || last_name = ?)";
+};
+/// @}
+
+/// @name Пользователи
+/// @{
+/**
+ * @brief Поиск пользователя по номеру читательского билета
+ */
+struct FindUser : sql::Statement<sql::Params<QString>, sql::Columns<int>> {
+    static constexpr char name[] = "find_user";
+    static constexpr char text[] = "SELECT user_id FROM users WHERE library_card_number = ?";
+    struct Row {
+        int user_id;
+    };
+};
+
+/**
+ * @brief Добавление пользователя: имя, фамилия, номер билета
+ */
+struct InsertUser : sql::Statement<sql::Params<QString, QString, QString>> {
+    static constexpr char name[] = "insert_user";
+    static constexpr char text[] =
+        "INSERT INTO users (first_name, last_name, library_card_number) VALUES (?, ?, ?)";
+};
+
+/**
+ * @brief Удаление пользователя по номеру билета
+ */
+struct DeleteUser : sql::Statement<sql::Params<QString>> {
+    static constexpr char name[] = "delete_user";
+    static constexpr char text[] = "DELETE FROM users WHERE library_card_number = ?";
+};
+/// @}
+
+/// @name Выдачи
+/// @{
+/**
+ * @brief Запись о выдаче книги (книга, пользователь) текущей датой
+ */
+struct InsertLoan : sql::Statement<sql::Params<int, int>> {
+    static constexpr char name[] = "insert_loan";
+    static constexpr char text[] =
+        "INSERT INTO book_loans (book_id, user_id, loan_date) VALUES (?, ?, CURRENT_DATE)";
+};
+
+/**
+ * @brief Поиск открытой выдачи (книга, пользователь)
+ */
+struct FindOpenLoan : sql::Statement<sql::Params<int, int>, sql::Columns<int>> {
+    static constexpr char name[] = "find_open_loan";
+    static constexpr char text[] =
+        "SELECT loan_id FROM book_loans WHERE book_id = ? AND user_id = ? AND return_date IS NULL";
+    struct Row {
+        int loan_id;
+    };
+};
+
+/**
+ * @brief Отметка о возврате текущей датой
+ */
+struct CloseLoan : sql::Statement<sql::Params<int>> {
+    static constexpr char name[] = "close_loan";
+    static constexpr char text[] =
+        "UPDATE book_loans SET return_date = CURRENT_DATE WHERE loan_id = ?";
+};
+
+/**
+ * @brief Журнал выдач для главного окна
+ */
+struct ListLoans : sql::Statement<sql::Params<>,
+                                  sql::Columns<QString, QString, QString, QString, QDate, std::optional<QDate>>> {
+    static constexpr char name[] = "list_loans";
+    static constexpr char text[] =
+        "SELECT u.library_card_number, u.first_name || ' ' || u.last_name AS user, "
+        "b.title, a.first_name || ' ' || a.last_name AS author, "
+        "bl.loan_date, bl.return_date FROM book_loans bl "
+        "JOIN books b ON bl.book_id = b.book_id "
+        "JOIN authors a ON b.author_id = a.author_id "
+        "JOIN users u ON bl.user_id = u.user_id";
+    struct Row {
+        QString card_number;
+        QString user;
+        QString title;
+        QString author;
+        QDate loan_date;
+        std::optional<QDate> return_date;
+    };
+};
+/// @}
+
+/// @name Кеш каталога (CatalogCache)
+/// @{
+/**
+ * @brief Время сервера (мс с эпохи Unix), от которого отсчитывается следующая дельта
+ */
+struct CatalogClock : sql::Statement<sql::Params<>, sql::Columns<qint64>> {
+    static constexpr char name[] = "catalog_clock";
+    static constexpr char text[] = "SELECT CAST(EXTRACT(EPOCH FROM now()) * 1000 AS bigint)";
+    struct Row {
+        qint64 now_ms;
+    };
+};
+
+/**
+ * @brief Все книги для полной загрузки снимка
+ */
+struct CatalogBooks : sql::Statement<sql::Params<>, sql::Columns<int, QString, QString, QString, int>> {
+    static constexpr char name[] = "catalog_books";
+    static constexpr char text[] =
+        "SELECT b.book_id, b.title, a.first_name || ' ' || a.last_name AS author, "
+        "c.name AS category, b.availability_count FROM books b "
+        "JOIN authors a ON b.author_id = a.author_id "
+        "JOIN categories c ON b.category_id = c.category_id";
+    struct Row {
+        int book_id;
+        QString title;
+        QString author;
+        QString category;
+        int availability_count;
+    };
+};
+
+/**
+ * @brief Книги, измененные после момента (мс с эпохи Unix)
+ * @note Автор выбирается по ключу для каждой строки: общий план не знает
+ * размера дельты (оценивает треть таблицы) и с соединением читал бы
+ * authors целиком. Для полной загрузки такой план медленнее, поэтому
+ * она выполняется отдельным оператором CatalogBooks
+ */
+struct CatalogBooksSince : sql::Statement<sql::Params<qint64>, sql::Columns<int, QString, QString, QString, int>> {
+    static constexpr char name[] = "catalog_books_since";
+    static constexpr char text[] =
+        "SELECT b.book_id, b.title, "
+        "(SELECT a.first_name || ' ' || a.last_name FROM authors a WHERE a.author_id = b.author_id) AS author, "
+        "c.name AS category, b.availability_count FROM books b "
+        "JOIN categories c ON b.category_id = c.category_id "
+        "WHERE b.updated_at > to_timestamp(? / 1000.0)";
+    struct Row {
+        int book_id;
+        QString title;
+        QString author;
+        QString category;
+        int availability_count;
+    };
+};
+
+/**
+ * @brief Пользователи, измененные после момента (мс с эпохи Unix); 0 — все
+ */
+struct CatalogUsersSince : sql::Statement<sql::Params<qint64>, sql::Columns<int, QString, QString>> {
+    static constexpr char name[] = "catalog_users_since";
+    static constexpr char text[] =
+        "SELECT u.user_id, u.library_card_number, u.first_name || ' ' || u.last_name AS user "
+        "FROM users u WHERE u.updated_at > to_timestamp(? / 1000.0)";
+    struct Row {
+        int user_id;
+        QString card_number;
+        QString name;
+    };
+};
+
+/**
+ * @brief Книги и пользователи, удаленные после момента (мс с эпохи Unix)
+ */
+struct CatalogDeletionsSince : sql::Statement<sql::Params<qint64>, sql::Columns<QString, int>> {
+    static constexpr char name[] = "catalog_deletions_since";
+    static constexpr char text[] =
+        "SELECT table_name, row_id FROM catalog_deletions WHERE deleted_at > to_timestamp(? / 1000.0)";
+    struct Row {
+        QString table_name;
+        int row_id;
+    };
+};
+
+/**
+ * @brief Количество книг и пользователей для проверки кеша
+ */
+struct CatalogCounts : sql::Statement<sql::Params<>, sql::Columns<int, int>> {
+    static constexpr char name[] = "catalog_counts";
+    static constexpr char text[] =
+        "SELECT (SELECT COUNT(*) FROM books), (SELECT COUNT(*) FROM users)";
+    struct Row {
+        int books;
+        int users;
+    };
+};
+/// @}
+
+/// @name Служебные
+/// @{
+/**
+ * @brief Текущая позиция WAL основной БД (байты от 0/0)
+ */
+struct WalPosition : sql::Statement<sql::Params<>, sql::Columns<qint64>> {
+    static constexpr char name[] = "wal_position";
+    static constexpr char text[] =
+        "SELECT CAST(pg_wal_lsn_diff(pg_current_wal_lsn(), '0/0') AS bigint)";
+    struct Row {
+        qint64 lsn;
+    };
+};
+
+/**
+ * @brief Позиция WAL, примененная репликой
+ *
+ * replayed_lsn равно NULL, если реплика еще ничего не применила; если
+ * сервер не в режиме восстановления (реплика повышена), in_recovery = false.
+ */
+struct ReplayPosition : sql::Statement<sql::Params<>, sql::Columns<bool, std::optional<qint64>>> {
+    static constexpr char name[] = "replay_position";
+    static constexpr char text[] =
+        "SELECT pg_is_in_recovery(), "
+        "       CAST(pg_wal_lsn_diff(pg_last_wal_replay_lsn(), '0/0') AS bigint)";
+    struct Row {
+        bool in_recovery;
+        std::optional<qint64> replayed_lsn;
+    };
+};
+/// @}
+
+/// @name Сверка фонда (InventoryReconciler)
+/// @{
+/**
+ * @brief Диапазон идентификаторов книг
+ */
+struct BookIdRange : sql::Statement<sql::Params<>, sql::Columns<int, int>> {
+    static constexpr char name[] = "book_id_range";
+    static constexpr char text[] =
+        "SELECT COALESCE(MIN(book_id), 0), COALESCE(MAX(book_id), -1) FROM books";
+    struct Row {
+        int min_id;
+        int max_id;
+    };
+};
+
+/**
+ * @brief Книги диапазона [from, to), у которых счетчик не равен
+ * total_copies минус открытые выдачи; диапазон передается дважды
+ */
+struct FindAvailabilityDrift : sql::Statement<sql::Params<int, int, int, int>, sql::Columns<int, int, int>> {
+    static constexpr char name[] = "find_availability_drift";
+    static constexpr char text[] =
+        "SELECT b.book_id, b.availability_count, b.total_copies - COALESCE(o.open_loans, 0) AS expected "
+        "FROM books b LEFT JOIN ("
+        "  SELECT book_id, COUNT(*) AS open_loans FROM book_loans "
+        "  WHERE return_date IS NULL AND book_id >= ? AND book_id < ? GROUP BY book_id) o "
+        "ON o.book_id = b.book_id "
+        "WHERE b.book_id >= ? AND b.book_id < ? "
+        "AND b.availability_count <> b.total_copies - COALESCE(o.open_loans, 0)";
+    struct Row {
+        int book_id;
+        int availability_count;
+        int expected;
+    };
+};
+
+/**
+ * @brief Ограничение ожидания блокировок до конца транзакции, например "2000ms"
+ */
+struct SetLockTimeout : sql::Statement<sql::Params<QString>> {
+    static constexpr char name[] = "set_lock_timeout";
+    static constexpr char text[] = "SELECT set_config('lock_timeout', ?, true)";
+};
+
+/**
+ * @brief Блокировка строк книг по массиву идентификаторов ("{1,2,3}")
+ */
+struct LockBooks : sql::Statement<sql::Params<QString>, sql::Columns<int>> {
+    static constexpr char name[] = "lock_books";
+    static constexpr char text[] =
+        "SELECT book_id FROM books WHERE book_id = ANY (CAST(? AS integer[])) "
+        "ORDER BY book_id FOR UPDATE";
+    struct Row {
+        int book_id;
+    };
+};
+
+/**
+ * @brief Исправление счетчиков книг из массива, которые все еще расходятся
+ */
+struct RepairAvailability : sql::Statement<sql::Params<QString>, sql::Columns<int, int>> {
+    static constexpr char name[] = "repair_availability";
+    static constexpr char text[] =
+        "UPDATE books b SET availability_count = e.expected FROM ("
+        "  SELECT b2.book_id, b2.total_copies - (SELECT COUNT(*) FROM book_loans l "
+        "         WHERE l.book_id = b2.book_id AND l.return_date IS NULL) AS expected "
+        "  FROM books b2 WHERE b2.book_id = ANY (CAST(? AS integer[]))) e "
+        "WHERE b.book_id = e.book_id AND b.availability_count <> e.expected "
+        "RETURNING b.book_id, b.availability_count";
+    struct Row {
+        int book_id;
+        int availability_count;
+    };
+};
+/// @}
+
+/// @name Просрочки (OverdueEngine)
+/// @{
+struct ClearOverdueReaders : sql::Statement<sql::Params<>> {
+    static constexpr char name[] = "clear_overdue_readers";
+    static constexpr char text[] = "DELETE FROM overdue_readers";
+};
+
+struct ClearOverdueLoans : sql::Statement<sql::Params<>> {
+    static constexpr char name[] = "clear_overdue_loans";
+    static constexpr char text[] = "DELETE FROM overdue_loans";
+};
+
+/**
+ * @brief Расчет просроченных выдач: дата расчета, срок и пеня по умолчанию
+ *
+ * Условие loan_date < cutoff позволяет идти по частичному индексу
+ * book_loans_open_idx и не читать давно возвращенные выдачи.
+ */
+struct ComputeOverdueLoans : sql::Statement<sql::Params<QDate, int, double>> {
+    static constexpr char name[] = "compute_overdue_loans";
+    static constexpr char text[] =
+        "WITH params AS ("
+        "  SELECT CAST(? AS date) AS as_of,"
+        "         CAST(? AS integer) AS default_days,"
+        "         CAST(? AS numeric) AS default_fine),"
+        " horizon AS ("
+        "  SELECT p.as_of, p.default_days, p.default_fine,"
+        "         p.as_of - LEAST(p.default_days,"
+        "                         COALESCE((SELECT MIN(loan_days) FROM loan_policies), p.default_days)) AS cutoff"
+        "  FROM params p) "
+        "INSERT INTO overdue_loans (loan_id, user_id, book_id, due_date, days_overdue, fine, computed_on) "
+        "SELECT bl.loan_id, bl.user_id, bl.book_id, d.due_date, h.as_of - d.due_date,"
+        "       (h.as_of - d.due_date) * COALESCE(lp.daily_fine, h.default_fine), h.as_of "
+        "FROM horizon h "
+        "JOIN book_loans bl ON bl.return_date IS NULL AND bl.loan_date < h.cutoff "
+        "JOIN books b ON b.book_id = bl.book_id "
+        "LEFT JOIN loan_policies lp ON lp.category_id = b.category_id "
+        "CROSS JOIN LATERAL (SELECT bl.loan_date + COALESCE(lp.loan_days, h.default_days) AS due_date) d "
+        "WHERE d.due_date < h.as_of";
+};
+
+struct ComputeOverdueReaders : sql::Statement<sql::Params<>> {
+    static constexpr char name[] = "compute_overdue_readers";
+    static constexpr char text[] =
+        "INSERT INTO overdue_readers "
+        "(user_id, overdue_count, max_days_overdue, total_fine, computed_on) "
+        "SELECT user_id, COUNT(*), MAX(days_overdue), SUM(fine), MAX(computed_on) "
+        "FROM overdue_loans GROUP BY user_id";
+};
+
+/**
+ * @brief Сводка просрочек по номеру билета
+ */
+struct ReaderOverdueStatus : sql::Statement<sql::Params<QString>, sql::Columns<int, int, double, QDate>> {
+    static constexpr char name[] = "reader_overdue_status";
+    static constexpr char text[] =
+        "SELECT r.overdue_count, r.max_days_overdue, r.total_fine, r.computed_on "
+        "FROM overdue_readers r JOIN users u ON u.user_id = r.user_id "
+        "WHERE u.library_card_number = ?";
+    struct Row {
+        int overdue_count;
+        int max_days_overdue;
+        double total_fine;
+        QDate computed_on;
+    };
+};
+
+/**
+ * @brief Отчет о просрочках, от наибольшей к наименьшей
+ */
+struct OverdueReport : sql::Statement<sql::Params<>, sql::Columns<QString, QString, QString, QDate, int, double>> {
+    static constexpr char name[] = "overdue_report";
+    static constexpr char text[] =
+        "SELECT u.library_card_number, u.first_name || ' ' || u.last_name AS user, "
+        "b.title, o.due_date, o.days_overdue, o.fine FROM overdue_loans o "
+        "JOIN users u ON u.user_id = o.user_id "
+        "JOIN books b ON b.book_id = o.book_id "
+        "ORDER BY o.days_overdue DESC";
+    struct Row {
+        QString card_number;
+        QString user;
+        QString title;
+        QDate due_date;
+        int days_overdue;
+        double fine;
+    };
+};
+
+/**
+ * @brief Размер истории выдач для отчета о замерах (overdue --bench)
+ */
+struct LoanCounts : sql::Statement<sql::Params<>, sql::Columns<qint64, qint64>> {
+    static constexpr char name[] = "loan_counts";
+    static constexpr char text[] =
+        "SELECT COUNT(*), COUNT(*) FILTER (WHERE return_date IS NULL) FROM book_loans";
+    struct Row {
+        qint64 loans;
+        qint64 open_loans;
+    };
+};
+/// @}
+
+/// @name Статистика (CirculationStats)
+/// @{
+/**
+ * @brief Самые выдаваемые книги по категориям: начало, конец периода, книг на категорию
+ */
+struct TopBooks : sql::Statement<sql::Params<QDate, QDate, int>, sql::Columns<QString, QString, QString, int>> {
+    static constexpr char name[] = "top_books";
+    static constexpr char text[] =
+        "SELECT COALESCE(c.name, '') AS category, b.title, "
+        "a.first_name || ' ' || a.last_name AS author, t.issues FROM ("
+        "  SELECT category_id, book_id, SUM(issues) AS issues, "
+        "         ROW_NUMBER() OVER (PARTITION BY category_id ORDER BY SUM(issues) DESC) AS rank "
+        "  FROM circulation_daily WHERE day >= ? AND day < ? AND issues > 0 "
+        "  GROUP BY category_id, book_id) t "
+        "JOIN books b ON b.book_id = t.book_id "
+        "JOIN authors a ON a.author_id = b.author_id "
+        "LEFT JOIN categories c ON c.category_id = t.category_id "
+        "WHERE t.rank <= ? "
+        "ORDER BY category, t.issues DESC";
+    struct Row {
+        QString category;
+        QString title;
+        QString author;
+        int issues;
+    };
+};
+
+/**
+ * @brief Читатели с книгами на руках
+ */
+struct ActiveReaders : sql::Statement<sql::Params<>,
+                                      sql::Columns<QString, QString, int, int, std::optional<QDate>>> {
+    static constexpr char name[] = "active_readers";
+    static constexpr char text[] =
+        "SELECT u.library_card_number, u.first_name || ' ' || u.last_name AS user, "
+        "r.current_loans, r.total_loans, r.last_loan_date FROM reader_loans r "
+        "JOIN users u ON u.user_id = r.user_id "
+        "WHERE r.current_loans > 0 ORDER BY r.current_loans DESC";
+    struct Row {
+        QString card_number;
+        QString user;
+        int current_loans;
+        int total_loans;
+        std::optional<QDate> last_loan_date;
+    };
+};
+/// @}
+
+} // namespace stmt
+
+#endif // STATEMENTS_H
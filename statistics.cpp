@@ -0,0 +1,44 @@
+#include "statistics.h"
+#include "logger.h"
+#include <QSqlError>
+
+/**
+ * @brief Конструктор
+ * @param library Библиотека, выбирающая подключение для чтения
+ */
+CirculationStats::CirculationStats(Library *library)
+    : library_(library)
+{
+}
+
+/**
+ * @brief Самые выдаваемые книги по категориям за период
+ * @param from Начало периода (включительно)
+ * @param to Конец периода (не включительно)
+ * @param per_category Количество книг в каждой категории
+ * @return Результат запроса
+ * @note Диапазон дат читается по первичному ключу circulation_daily,
+ * объем работы пропорционален числу книг, выданных за период
+ */
+sql::Result<stmt::TopBooks> CirculationStats::top_books(const QDate &from, const QDate &to, int per_category)
+{
+    auto query = library_->read<stmt::TopBooks>(from, to, per_category);
+    if (!query.ok()) {
+        LOG_ERROR("top_books").sql(query.error()).message("ошибка построения статистики выдач");
+    }
+    return query;
+}
+
+/**
+ * @brief Читатели с книгами на руках
+ * @return Результат запроса
+ * @note Использует частичный индекс reader_loans_active_idx
+ */
+sql::Result<stmt::ActiveReaders> CirculationStats::active_readers()
+{
+    auto query = library_->read<stmt::ActiveReaders>();
+    if (!query.ok()) {
+        LOG_ERROR("active_readers").sql(query.error()).message("ошибка построения списка активных читателей");
+    }
+    return query;
+}
@@ -0,0 +1,46 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <QDate>
+#include "library.h"
+#include "statements.h"
+
+/**
+ * @brief Статистика книговыдачи
+ *
+ * Читает таблицы circulation_daily и reader_loans, которые триггер
+ * book_loans_circulation_stats поддерживает в той же транзакции, что и
+ * выдача или возврат книги. Запросы не агрегируют историю выдач целиком,
+ * а читают только строки запрошенного периода.
+ *
+ * Запросы выполняются через Library::read и при наличии свежей реплики
+ * не нагружают основную БД.
+ */
+class CirculationStats {
+public:
+    /**
+     * @brief Конструктор
+     * @param library Библиотека, выбирающая подключение для чтения
+     */
+    explicit CirculationStats(Library* library);
+
+    /**
+     * @brief Самые выдаваемые книги по категориям за период
+     * @param from Начало периода (включительно)
+     * @param to Конец периода (не включительно)
+     * @param per_category Количество книг в каждой категории
+     * @return Результат запроса stmt::TopBooks
+     */
+    sql::Result<stmt::TopBooks> top_books(const QDate& from, const QDate& to, int per_category);
+
+    /**
+     * @brief Читатели, у которых сейчас есть книги на руках
+     * @return Результат запроса stmt::ActiveReaders
+     */
+    sql::Result<stmt::ActiveReaders> active_readers();
+
+private:
+    Library* library_; ///< Библиотека, выбирающая подключение для чтения
+};
+
+#endif // STATISTICS_H
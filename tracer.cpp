@@ -0,0 +1,185 @@
+#include "tracer.h"
+#include "logger.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QByteArray>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tracing {
+namespace {
+
+/**
+ * @brief Завершенный интервал
+ */
+struct Event {
+    const char *name;
+    const char *category;
+    qint64 begin_ns;     ///< Начало по steady_clock
+    qint64 duration_ns;
+    quint64 session;     ///< Сеанс трассировки, в котором открыт интервал
+};
+
+/**
+ * @brief Буфер интервалов одного потока
+ *
+ * Мьютекс захватывает только поток-владелец и, при остановке, поток,
+ * сохраняющий файл, поэтому он практически всегда свободен.
+ */
+struct ThreadBuffer {
+    std::mutex mutex;
+    std::vector<Event> events;
+    int tid = 0;
+};
+
+std::atomic<bool> g_enabled{false};
+/// Номер сеанса; растет при каждом start(), чтобы интервал, открытый до
+/// перезапуска трассировки, не попал в след нового сеанса
+std::atomic<quint64> g_session{0};
+qint64 g_origin_ns = 0;  ///< Начало текущего сеанса (под g_registry_mutex)
+std::mutex g_registry_mutex;
+std::vector<std::shared_ptr<ThreadBuffer>> g_buffers;
+QString g_path;
+
+/// Время по steady_clock; в след пишется относительно g_origin_ns при остановке
+qint64 now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ThreadBuffer &local_buffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+        buffer = std::make_shared<ThreadBuffer>();
+        buffer->events.reserve(4096);
+        std::lock_guard<std::mutex> lock(g_registry_mutex);
+        buffer->tid = int(g_buffers.size()) + 1;
+        g_buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void append_micros(QByteArray &out, qint64 ns)
+{
+    out += QByteArray::number(ns / 1000);
+    out += '.';
+    out += QByteArray::number(ns % 1000).rightJustified(3, '0');
+}
+
+} // namespace
+
+/**
+ * @brief Включает запись интервалов
+ * @param path Путь к JSON-файлу
+ */
+void start(const QString &path)
+{
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    if (g_enabled.load()) {
+        return;
+    }
+    g_path = path;
+    g_origin_ns = now_ns();
+    // Интервалы, дописанные в буферы после прошлой остановки, новому сеансу не нужны
+    for (const std::shared_ptr<ThreadBuffer> &buffer : g_buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->events.clear();
+    }
+    g_session.fetch_add(1, std::memory_order_acq_rel);
+    g_enabled.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief Выключает запись и сохраняет накопленные интервалы
+ * @return true если файл записан
+ * @note Интервалы других сеансов (завершенные на границе остановки или
+ * перезапуска) отбрасываются
+ */
+bool stop()
+{
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    if (!g_enabled.exchange(false)) {
+        return false;
+    }
+    const quint64 session = g_session.load(std::memory_order_acquire);
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QByteArray out;
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + QByteArray::number(pid)
+         + ",\"args\":{\"name\":\"library\"}}";
+    for (const std::shared_ptr<ThreadBuffer> &buffer : g_buffers) {
+        std::vector<Event> events;
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            events.swap(buffer->events);
+        }
+        for (const Event &event : events) {
+            if (event.session != session || event.begin_ns < g_origin_ns) {
+                continue;
+            }
+            out += ",\n{\"name\":\"";
+            out += event.name;
+            out += "\",\"cat\":\"";
+            out += event.category;
+            out += "\",\"ph\":\"X\",\"ts\":";
+            append_micros(out, event.begin_ns - g_origin_ns);
+            out += ",\"dur\":";
+            append_micros(out, event.duration_ns);
+            out += ",\"pid\":" + QByteArray::number(pid) + ",\"tid\":" + QByteArray::number(buffer->tid) + "}";
+        }
+    }
+    out += "\n]}\n";
+
+    QFile file(g_path);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(out) != out.size()) {
+        LOG_ERROR("trace_stop").message("не удалось записать файл трассировки");
+        return false;
+    }
+    return true;
+}
+
+bool enabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+QString path_from_environment()
+{
+    return qEnvironmentVariable("LIBRARY_TRACE_FILE");
+}
+
+/**
+ * @brief Открывает интервал; при выключенной трассировке ничего не записывает
+ */
+Span::Span(const char *name, const char *category)
+    : name_(name), category_(category), begin_ns_(-1)
+{
+    if (g_enabled.load(std::memory_order_acquire)) {
+        session_ = g_session.load(std::memory_order_acquire);
+        begin_ns_ = now_ns();
+    }
+}
+
+/**
+ * @brief Записывает интервал в буфер текущего потока
+ * @note Интервал, открытый в другом сеансе трассировки, отбрасывается
+ */
+void Span::finish()
+{
+    const qint64 end = now_ns();
+    if (g_enabled.load(std::memory_order_acquire)
+        && g_session.load(std::memory_order_acquire) == session_) {
+        ThreadBuffer &buffer = local_buffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.events.push_back({name_, category_, begin_ns_, end - begin_ns_, session_});
+    }
+    begin_ns_ = -1;
+}
+
+} // namespace tracing
@@ -0,0 +1,105 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+#include <QtGlobal>
+
+/**
+ * @brief Трассировка операций в формате Chrome Trace (Perfetto)
+ *
+ * Участок кода отмечается объектом Span на время его жизни:
+ * @code
+ * TRACE_SPAN("Library::issue_book");
+ * @endcode
+ * Пока трассировка выключена, Span только читает один атомарный флаг.
+ * Во включенном состоянии интервалы накапливаются в буферах потоков и
+ * записываются в JSON-файл при остановке; файл открывается в
+ * ui.perfetto.dev или chrome://tracing.
+ */
+namespace tracing {
+
+/**
+ * @brief Включает запись интервалов
+ * @param path Путь к JSON-файлу, в который будет записан след при остановке
+ */
+void start(const QString& path);
+
+/**
+ * @brief Выключает запись и сохраняет накопленные интервалы
+ * @return true если файл записан
+ */
+bool stop();
+
+/**
+ * @brief Включена ли трассировка
+ */
+bool enabled();
+
+/**
+ * @brief Путь к файлу следа из переменной окружения LIBRARY_TRACE_FILE
+ * @return Путь или пустая строка, если трассировка не запрошена
+ */
+QString path_from_environment();
+
+/**
+ * @brief Включает трассировку по LIBRARY_TRACE_FILE на время жизни объекта
+ * (обычно в main); при разрушении сохраняет след
+ */
+class Session {
+public:
+    Session()
+    {
+        const QString path = path_from_environment();
+        if (!path.isEmpty()) {
+            start(path);
+        }
+    }
+    ~Session() { stop(); }
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+};
+
+/**
+ * @brief Интервал трассировки от создания до end() или разрушения
+ */
+class Span {
+public:
+    /**
+     * @brief Открывает интервал
+     * @param name Название (строковый литерал)
+     * @param category Категория (строковый литерал): ui, app, sql
+     */
+    explicit Span(const char *name, const char *category = "app");
+    ~Span() { end(); }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    /**
+     * @brief Закрывает интервал раньше конца области видимости
+     */
+    void end()
+    {
+        if (begin_ns_ >= 0) {
+            finish();
+        }
+    }
+
+private:
+    void finish();
+
+    const char *name_;      ///< Название интервала
+    const char *category_;  ///< Категория интервала
+    qint64 begin_ns_;       ///< Начало (нс по steady_clock) или -1, если не записывается
+    quint64 session_ = 0;   ///< Сеанс трассировки, в котором открыт интервал
+};
+
+} // namespace tracing
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+/// Интервал на оставшуюся часть текущей области видимости
+#define TRACE_SPAN(...) ::tracing::Span TRACE_CONCAT(trace_span_, __LINE__)(__VA_ARGS__)
+
+#endif // TRACER_H
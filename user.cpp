@@ -1,8 +1,9 @@
 #include "user.h"
+#include "statements.h"
+#include "logger.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
-#include <QDebug>
 
 /**
  * @brief Конструктор класса User
@@ -43,17 +44,13 @@ QString User::getCardNumber() const {
  * @brief Добавляет пользователя в базу данных
  * @param user Объект пользователя для добавления
  * @return true при успешном добавлении, false при ошибке
- * @note В случае ошибки выводит сообщение в консоль отладки
+ * @note В случае ошибки записывает событие в журнал (logger.h)
  */
 bool User::addUser(const User &user) {
-    QSqlQuery query;
-    query.prepare("INSERT INTO users (first_name, last_name, library_card_number) "
-                  "VALUES (:firstName, :lastName, :cardNumber)");
-    query.bindValue(":firstName", user.getFirstName());
-    query.bindValue(":lastName", user.getLastName());
-    query.bindValue(":cardNumber", user.getCardNumber());
-    if (!query.exec()) {
-        qWarning() << "Ошибка добавления пользователя:" << query.lastError().text();
+    auto query = sql::default_cache().exec<stmt::InsertUser>(
+        user.getFirstName(), user.getLastName(), user.getCardNumber());
+    if (!query.ok()) {
+        LOG_ERROR("add_user").card(user.getCardNumber()).sql(query.error()).message("ошибка добавления пользователя");
         return false;
     }
     return true;
@@ -63,14 +60,12 @@ bool User::addUser(const User &user) {
  * @brief Удаляет пользователя из базы данных
  * @param cardNumber Номер библиотечной карты пользователя для удаления
  * @return true при успешном удалении, false при ошибке
- * @note В случае ошибки выводит сообщение в консоль отладки
+ * @note В случае ошибки записывает событие в журнал (logger.h)
  */
 bool User::deleteUser(const QString &cardNumber) {
-    QSqlQuery query;
-    query.prepare("DELETE FROM users WHERE library_card_number = :cardNumber");
-    query.bindValue(":cardNumber", cardNumber);
-    if (!query.exec()) {
-        qWarning() << "Ошибка удаления пользователя:" << query.lastError().text();
+    auto query = sql::default_cache().exec<stmt::DeleteUser>(cardNumber);
+    if (!query.ok()) {
+        LOG_ERROR("delete_user").card(cardNumber).sql(query.error()).message("ошибка удаления пользователя");
         return false;
     }
     return true;